@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "debug.h"
+#include "arena.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+Arena *Arena_create(size_t chunk_size) {
+	Arena *arena = calloc(1, sizeof(Arena));
+	check_mem(arena);
+	mem_arena(arena, MEM_ARENA, sizeof(Arena));
+
+	arena->chunk_size = chunk_size > 0 ? chunk_size : ARENA_DEFAULT_CHUNK_SIZE;
+
+	return arena;
+error:
+	return NULL;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Slow path of Arena_alloc: the current chunk is full, start a new one.
+// Requests bigger than a chunk get a chunk of their own.
+void *Arena_alloc_chunk(Arena *arena, size_t size) {
+	size_t chunk_size = size > arena->chunk_size ? size : arena->chunk_size;
+
+	ArenaChunk *chunk = malloc(sizeof(ArenaChunk) + chunk_size);
+	check_mem(chunk);
+
+	chunk->size = chunk_size;
+	chunk->used = size;
+
+	mem_arena(arena, MEM_ARENA, sizeof(ArenaChunk) + chunk_size);
+
+	arena->mallocs++;
+	arena->reserved += chunk_size;
+	if (arena->reserved > arena->peak)
+		arena->peak = arena->reserved;
+
+	// Keep the chunk with the most room in front so small allocations
+	// don't strand the rest of it after an oversized request.
+	if (arena->first && size == chunk_size) {
+		chunk->next = arena->first->next;
+		arena->first->next = chunk;
+	} else {
+		chunk->next = arena->first;
+		arena->first = chunk;
+	}
+
+	return chunk->data;
+error:
+	return NULL;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Grow ptr, which was allocated with old_size bytes, to size bytes. The
+// last allocation in the current chunk grows in place when there's room;
+// anything else is copied and the old space is simply left behind.
+void *Arena_realloc(Arena *arena, void *ptr, size_t old_size, size_t size) {
+	ArenaChunk *chunk = arena->first;
+	size_t old_aligned = (old_size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+	size_t aligned = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+	if (ptr == NULL)
+		return Arena_alloc(arena, size);
+
+	if (chunk && (char *)ptr + old_aligned == chunk->data + chunk->used
+			&& chunk->used - old_aligned + aligned <= chunk->size) {
+		chunk->used = chunk->used - old_aligned + aligned;
+		return ptr;
+	}
+
+	void *copy = Arena_alloc(arena, size);
+	if (copy)
+		memcpy(copy, ptr, old_size < size ? old_size : size);
+	return copy;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Copy length bytes of str into the arena, NUL-terminated.
+char *Arena_strndup(Arena *arena, const char *str, size_t length) {
+	char *copy = Arena_alloc(arena, length + 1);
+	check_mem(copy);
+
+	memcpy(copy, str, length);
+	copy[length] = '\0';
+
+	return copy;
+error:
+	return NULL;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+void Arena_stats(Arena *arena, ArenaStats *stats) {
+	ArenaChunk *chunk;
+
+	stats->allocs = arena->allocs;
+	stats->mallocs = arena->mallocs;
+	stats->reserved = arena->reserved;
+	stats->peak = arena->peak;
+	stats->used = 0;
+
+	for (chunk = arena->first; chunk; chunk = chunk->next)
+		stats->used += chunk->used;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// The arena's own chunks are accounted to MEM_ARENA, heap memory like any
+// other; what other subsystems take from them is theirs as well.
+void Arena_account(Arena *arena, MemSubsystem sub, size_t bytes) {
+	arena->accounted[sub] += bytes;
+	MemStats_alloc(sub, bytes);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Give back up to bytes of what sub has accounted to arena.
+static void Arena_unaccount(Arena *arena, MemSubsystem sub, size_t bytes) {
+	if (bytes > arena->accounted[sub])
+		bytes = arena->accounted[sub];
+
+	if (bytes > 0) {
+		arena->accounted[sub] -= bytes;
+		MemStats_free(sub, bytes);
+	}
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Everything but the arena's chunks and the Arena itself.
+static void Arena_unaccount_all(Arena *arena) {
+	int sub;
+
+	for (sub = 0; sub < MEM_SUBSYSTEM_COUNT; sub++) {
+		if (sub != MEM_ARENA)
+			Arena_unaccount(arena, sub, arena->accounted[sub]);
+	}
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Forget everything allocated so far. One regular-sized chunk is kept, so
+// an arena reused for many small jobs doesn't go back to malloc each time.
+void Arena_reset(Arena *arena) {
+	ArenaChunk *keep = NULL, *chunk = arena->first;
+
+	while (chunk) {
+		ArenaChunk *next = chunk->next;
+		if (keep == NULL && chunk->size == arena->chunk_size) {
+			keep = chunk;
+		} else {
+			Arena_unaccount(arena, MEM_ARENA, sizeof(ArenaChunk) + chunk->size);
+			free(chunk);
+		}
+		chunk = next;
+	}
+
+	Arena_unaccount_all(arena);
+
+	if (keep) {
+		keep->next = NULL;
+		keep->used = 0;
+	}
+	arena->first = keep;
+
+	// Counts start over for the arena's next job.
+	arena->allocs = arena->mallocs = 0;
+	arena->reserved = arena->peak = keep ? keep->size : 0;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+void Arena_destroy(Arena *arena) {
+	if (arena == NULL)
+		return;
+
+	ArenaChunk *chunk = arena->first;
+	while (chunk) {
+		ArenaChunk *next = chunk->next;
+		Arena_unaccount(arena, MEM_ARENA, sizeof(ArenaChunk) + chunk->size);
+		free(chunk);
+		chunk = next;
+	}
+
+	Arena_unaccount_all(arena);
+	Arena_unaccount(arena, MEM_ARENA, sizeof(Arena));
+	free(arena);
+}
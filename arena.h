@@ -0,0 +1,72 @@
+#ifndef _MANANA_ARENA_H
+#define _MANANA_ARENA_H
+
+#include <stdlib.h>
+#include "debug.h"
+#include "memstats.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+#define ARENA_DEFAULT_CHUNK_SIZE (64 * 1024)
+#define ARENA_ALIGN 16
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// A bump allocator. Memory handed out by an Arena is never freed on its
+// own; all of it goes away at once in Arena_destroy, or in Arena_reset when
+// the arena is about to be reused.
+typedef struct ArenaChunk {
+	struct ArenaChunk *next;
+	size_t size, used;
+	_Alignas(ARENA_ALIGN) char data[];
+} ArenaChunk;
+
+// allocs counts Arena_alloc calls and mallocs the chunks behind them;
+// reserved is the bytes of chunk currently held and peak the most ever.
+// accounted is what each subsystem took from it while allocation
+// accounting was on (see memstats.h), given back when it's reset.
+typedef struct Arena {
+	ArenaChunk *first;
+	size_t chunk_size;
+	size_t allocs, mallocs, reserved, peak;
+	size_t accounted[MEM_SUBSYSTEM_COUNT];
+} Arena;
+
+typedef struct ArenaStats {
+	size_t allocs, mallocs, used, reserved, peak;
+} ArenaStats;
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+Arena *Arena_create(size_t chunk_size);
+void *Arena_alloc_chunk(Arena *arena, size_t size);
+void *Arena_realloc(Arena *arena, void *ptr, size_t old_size, size_t size);
+char *Arena_strndup(Arena *arena, const char *str, size_t length);
+void Arena_stats(Arena *arena, ArenaStats *stats);
+void Arena_account(Arena *arena, MemSubsystem sub, size_t bytes);
+void Arena_reset(Arena *arena);
+void Arena_destroy(Arena *arena);
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static inline void *
+Arena_alloc(Arena *arena, size_t size) 
+{
+	ArenaChunk *chunk = arena->first;
+	size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+	arena->allocs++;
+
+	if (chunk && chunk->used + size <= chunk->size) {
+		void *ptr = chunk->data + chunk->used;
+		chunk->used += size;
+		return ptr;
+	}
+
+	return Arena_alloc_chunk(arena, size);
+}
+
+// Count bytes taken from arena by sub, until the arena is reset.
+#define mem_arena(ARENA, SUB, BYTES)\
+	do {\
+		if (mem_accounting_enabled())\
+			Arena_account((ARENA), (SUB), (BYTES));\
+	} while (0)
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+#endif
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h> 
+#include <string.h>
 #include "debug.h"
 #include "array.h"
 
@@ -13,10 +14,11 @@ Array *Array_create(size_t element_size, size_t initial_max) {
 
 	array->contents = calloc(initial_max, sizeof(void*));
 	check_mem(array->contents);
+	mem_alloc(MEM_ARRAY, sizeof(Array) + initial_max * sizeof(void*));
 
 	array->end = 0;
+	array->min = initial_max;
 	array->element_size = element_size;
-	array->expand_rate = DEFAULT_EXPAND_RATE;
 
 	return array;
 error:
@@ -39,16 +41,22 @@ void Array_clear(Array *array) {
 }
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Reallocate to new_size slots, zeroing any new ones.
 static inline int 
-Array_resize(Array *array, size_t new_size) 
+Array_resize(Array *array, int new_size) 
 {
-	array->max = new_size;
-	check(array->max > 0, "New array size must be > 0.");
+	int old_max = array->max;
+	check(new_size > 0, "New array size must be > 0.");
 
-	void *contents = realloc(array->contents, array->max * sizeof(void*));
+	void **contents = realloc(array->contents, new_size * sizeof(void*));
 	check_mem(contents);
+	mem_realloc(MEM_ARRAY, old_max * sizeof(void*), new_size * sizeof(void*));
+
+	if (new_size > old_max)
+		memset(contents + old_max, 0, (new_size - old_max) * sizeof(void*));
 
 	array->contents = contents;
+	array->max = new_size;
 
 	return 0;
 error:
@@ -56,13 +64,10 @@ error:
 }
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Double the array.
 int Array_expand(Array *array) {
-	size_t old_max = array->max;
-	check(Array_resize(array, array->max + array->expand_rate) == 0,
-			"Failed to expand array to new size: %d",
-			array->max + (int)array->expand_rate);
-
-	memset(array->contents + old_max, 0, array->expand_rate + 1);
+	check(Array_resize(array, array->max * 2) == 0,
+			"Failed to expand array to new size: %d", array->max * 2);
 
 	return 0;
 error:
@@ -70,16 +75,40 @@ error:
 }
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Halve the array, but not below min or what's in it.
 int Array_contract(Array *array) {
-	int expand_rate = (int)array->expand_rate;
-	int new_size = array->end < expand_rate ? expand_rate : array->end;
+	int new_size = array->max / 2;
+
+	if (new_size < array->min)
+		new_size = array->min;
+	if (new_size < array->end)
+		new_size = array->end;
+
+	return new_size < array->max ? Array_resize(array, new_size) : 0;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Make room for count elements in all, and keep it when popping.
+int Array_reserve(Array *array, int count) {
+	if (count > array->min)
+		array->min = count;
+
+	return count > array->max ? Array_resize(array, count) : 0;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Give back every slot past end, and forget any reservation.
+int Array_shrink_to_fit(Array *array) {
+	int new_size = array->end > 0 ? array->end : 1;
 
-	return Array_resize(array, new_size + 1);
+	array->min = new_size;
+	return new_size < array->max ? Array_resize(array, new_size) : 0;
 }
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 void Array_destroy(Array *array) {
 	if(array) {
+		mem_free(MEM_ARRAY, sizeof(Array) + array->max * sizeof(void*));
 		if(array->contents) {
 			free(array->contents);
 		}
@@ -95,14 +124,13 @@ void Array_clear_destroy(Array *array) {
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 int Array_push(Array *array, void *el) {
+	if (Array_end(array) == Array_max(array) && Array_expand(array) != 0)
+		return -1;
+
 	array->contents[array->end] = el;
 	array->end++;
 
-	if (Array_end(array) >= Array_max(array)) {
-		return Array_expand(array);
-	} else {
-		return 0;
-	}
+	return 0;
 }
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
@@ -112,7 +140,8 @@ void *Array_pop(Array *array) {
 	void *el = Array_remove(array, array->end - 1);
 	array->end--;
 
-	if (Array_end(array) > (int)array->expand_rate && Array_end(array) % array->expand_rate) {
+	// Only at a quarter full, so the next push won't have to grow it back.
+	if (Array_end(array) <= Array_max(array) / 4 && Array_max(array) > array->min) {
 		Array_contract(array);
 	}
 
@@ -6,14 +6,17 @@
 #include <stdlib.h> 
 #include <assert.h>
 #include "debug.h"
+#include "memstats.h"
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
-#define DEFAULT_EXPAND_RATE 50
-
-// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// A growable array of pointers. It doubles when full and halves once it
+// is down to a quarter full, so pushes and pops are amortized O(1) and
+// going back and forth across a boundary never reallocs every time. It
+// never shrinks below min, the initial_max it was created with (or what
+// was last asked for with Array_reserve). Slots past end are NULL.
 typedef struct Array {
-	int end, max;
-	size_t element_size, expand_rate;
+	int end, max, min;
+	size_t element_size;
 	void **contents;
 } Array;
 
@@ -23,6 +26,8 @@ void Array_destroy(Array *array);
 void Array_clear(Array *array);
 int Array_expand(Array *array);
 int Array_contract(Array *array);
+int Array_reserve(Array *array, int count);
+int Array_shrink_to_fit(Array *array);
 int Array_push(Array *array, void *el);
 void *Array_pop(Array *array);
 void Array_clear_destroy(Array *array);
@@ -77,5 +82,64 @@ error:
 	return NULL;
 }
 
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// A typed array, for elements stored by value rather than as pointers:
+//
+//     ARRAY_OF(IntArray, int)
+//
+//     IntArray a = { 0 };
+//     IntArray_push(&a, 42);
+//     int x = IntArray_pop(&a);
+//     IntArray_release(&a);
+//
+// NAME grows and shrinks like Array, down to 16 slots. It starts out
+// zeroed; popping an empty one is the caller's problem, like indexing
+// past end.
+#define ARRAY_OF(NAME, TYPE)\
+	typedef struct NAME {\
+		TYPE *items;\
+		int end, max;\
+	} NAME;\
+\
+	static inline int NAME##_resize(NAME *array, int max) {\
+		TYPE *items = realloc(array->items, (max > 0 ? max : 1) * sizeof(TYPE));\
+		if (items == NULL)\
+			return -1;\
+		mem_realloc(MEM_ARRAY, array->max * sizeof(TYPE), (max > 0 ? max : 1) * sizeof(TYPE));\
+		array->items = items;\
+		array->max = max > 0 ? max : 1;\
+		return 0;\
+	}\
+\
+	static inline int NAME##_reserve(NAME *array, int count) {\
+		return count > array->max ? NAME##_resize(array, count) : 0;\
+	}\
+\
+	static inline int NAME##_shrink_to_fit(NAME *array) {\
+		return array->end < array->max ? NAME##_resize(array, array->end) : 0;\
+	}\
+\
+	static inline int NAME##_push(NAME *array, TYPE el) {\
+		if (array->end == array->max && NAME##_resize(array, array->max * 2) != 0)\
+			return -1;\
+		array->items[array->end++] = el;\
+		return 0;\
+	}\
+\
+	static inline TYPE NAME##_pop(NAME *array) {\
+		TYPE el = array->items[--array->end];\
+		if (array->max > 16 && array->end <= array->max / 4)\
+			NAME##_resize(array, array->max / 2);\
+		return el;\
+	}\
+\
+	static inline void NAME##_release(NAME *array) {\
+		if (array->items)\
+			mem_free(MEM_ARRAY, array->max * sizeof(TYPE));\
+		free(array->items);\
+		array->items = NULL;\
+		array->end = array->max = 0;\
+	}
+
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 #endif
@@ -0,0 +1,261 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "debug.h"
+#include "batch.h"
+#include "cache.h"
+#include "source.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// A worker's share of the files, largest first. The owner takes from the
+// head and thieves from the tail, so they only meet on the last file.
+typedef struct BatchQueue {
+	pthread_mutex_t lock;
+	int *jobs, head, tail;
+} BatchQueue;
+
+typedef struct BatchWorker {
+	pthread_t thread;
+	Batch *batch;
+	struct BatchWorker *workers;
+	int id, threads;
+	BatchQueue queue;
+	Arena *arena;
+	BatchVisit visit;
+	void *ctx;
+} BatchWorker;
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Largest first; equal sizes keep the order the paths were given in.
+static int compare_sizes(const void *a, const void *b) {
+	const BatchFile *x = *(BatchFile **)a, *y = *(BatchFile **)b;
+
+	if (x->size != y->size)
+		return x->size < y->size ? 1 : -1;
+	return x < y ? -1 : x > y;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// The paths are borrowed and must outlive the Batch. Files that can't be
+// stat'd are still part of the batch and fail when they're lexed.
+Batch *Batch_create(Array *paths) {
+	BatchFile **sorted = NULL;
+	int i;
+
+	Batch *batch = calloc(1, sizeof(Batch));
+	check_mem(batch);
+
+	batch->count = Array_count(paths);
+	batch->files = calloc(batch->count + 1, sizeof(BatchFile));
+	batch->order = calloc(batch->count + 1, sizeof(int));
+	sorted = calloc(batch->count + 1, sizeof(BatchFile *));
+	check_mem(batch->files && batch->order && sorted);
+
+	for (i = 0; i < batch->count; i++) {
+		struct stat st;
+		BatchFile *file = &batch->files[i];
+
+		file->path = Array_get(paths, i);
+		file->size = stat(file->path, &st) == 0 ? st.st_size : 0;
+		sorted[i] = file;
+	}
+
+	qsort(sorted, batch->count, sizeof(BatchFile *), compare_sizes);
+	for (i = 0; i < batch->count; i++)
+		batch->order[i] = sorted[i] - batch->files;
+
+	free(sorted);
+	return batch;
+error:
+	free(sorted);
+	Batch_destroy(batch);
+	return NULL;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+void Batch_destroy(Batch *batch) {
+	if (batch == NULL)
+		return;
+
+	free(batch->files);
+	free(batch->order);
+	free(batch);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static int BatchQueue_take(BatchQueue *queue, int steal) {
+	int job = -1;
+
+	pthread_mutex_lock(&queue->lock);
+	if (queue->head < queue->tail)
+		job = steal ? queue->jobs[--queue->tail] : queue->jobs[queue->head++];
+	pthread_mutex_unlock(&queue->lock);
+
+	return job;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Own queue first, then the others starting with the next worker along.
+// Nothing is queued once the pool starts, so when every queue is empty
+// the batch is done.
+static int BatchWorker_next(BatchWorker *worker) {
+	int i, job = BatchQueue_take(&worker->queue, 0);
+
+	for (i = 1; job < 0 && i < worker->threads; i++)
+		job = BatchQueue_take(&worker->workers[(worker->id + i) % worker->threads].queue, 1);
+
+	return job;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static void BatchWorker_lex(BatchWorker *worker, BatchFile *file) {
+	Source *source = Source_open(file->path);
+	if (source == NULL) {
+		file->tokens = -1;
+		snprintf(file->error, sizeof(file->error), "Can't load file: %s", strerror(errno));
+		return;
+	}
+
+	Buffer *buf = Buffer_create_in(source->data, source->size, worker->arena);
+	if (buf == NULL) {
+		file->tokens = -1;
+		snprintf(file->error, sizeof(file->error), "Out of memory.");
+		Source_close(source);
+		return;
+	}
+
+	buf->symbols = worker->batch->symbols;
+	buf->backend = worker->batch->backend;
+	file->size = source->size;
+	file->tokens = worker->batch->cache ? tokenize_cached(buf, file->path) : tokenize(buf);
+
+	if (file->tokens < 0) {
+		file->error_line = buf->error_line;
+		file->error_column = buf->error_column;
+		memcpy(file->error, buf->error_message, sizeof(file->error));
+	} else if (worker->visit) {
+		worker->visit(buf, file, worker->ctx);
+	}
+
+	Arena_stats(worker->arena, &file->memory);
+	Buffer_destroy(buf);
+	Arena_reset(worker->arena);
+	Source_close(source);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static void *BatchWorker_run(void *arg) {
+	BatchWorker *worker = arg;
+	int job;
+
+	while ((job = BatchWorker_next(worker)) >= 0)
+		BatchWorker_lex(worker, &worker->batch->files[job]);
+
+	return NULL;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Lex every file in the batch on threads workers. Returns the number of
+// files that failed, or -1 if the pool couldn't be started.
+int Batch_run(Batch *batch, int threads, BatchVisit visit, void *ctx) {
+	int i, started = 0;
+
+	if (threads < 1)
+		threads = 1;
+
+	BatchWorker *workers = calloc(threads, sizeof(BatchWorker));
+	check_mem(workers);
+
+	int share = batch->count / threads + 1;
+
+	for (i = 0; i < threads; i++) {
+		BatchWorker *worker = &workers[i];
+
+		worker->batch = batch;
+		worker->workers = workers;
+		worker->id = i;
+		worker->threads = threads;
+		worker->visit = visit;
+		worker->ctx = ctx;
+		pthread_mutex_init(&worker->queue.lock, NULL);
+
+		worker->arena = Arena_create(0);
+		worker->queue.jobs = malloc(share * sizeof(int));
+		check_mem(worker->arena && worker->queue.jobs);
+	}
+
+	// Deal largest-first so every worker starts on one of the big files.
+	for (i = 0; i < batch->count; i++) {
+		BatchFile *file = &batch->files[batch->order[i]];
+		BatchQueue *queue = &workers[i % threads].queue;
+
+		queue->jobs[queue->tail++] = batch->order[i];
+		file->tokens = file->error_line = file->error_column = 0;
+		file->error[0] = '\0';
+		memset(&file->memory, 0, sizeof(file->memory));
+	}
+
+	double start = now();
+
+	for (started = 0; started < threads; started++) {
+		if (pthread_create(&workers[started].thread, NULL, BatchWorker_run, &workers[started]) != 0)
+			break;
+	}
+	check(started > 0, "Can't start batch workers.");
+
+	// Workers that failed to start are stolen from by the others.
+	for (i = 0; i < started; i++)
+		pthread_join(workers[i].thread, NULL);
+
+	batch->seconds = now() - start;
+	batch->bytes = batch->tokens = 0;
+	batch->failed = 0;
+
+	for (i = 0; i < batch->count; i++) {
+		BatchFile *file = &batch->files[i];
+
+		batch->bytes += file->size;
+		if (file->tokens < 0)
+			batch->failed++;
+		else
+			batch->tokens += file->tokens;
+	}
+
+error:
+	if (workers) {
+		for (i = 0; i < threads; i++) {
+			if (workers[i].batch)
+				pthread_mutex_destroy(&workers[i].queue.lock);
+			free(workers[i].queue.jobs);
+			Arena_destroy(workers[i].arena);
+		}
+		free(workers);
+	}
+
+	return started > 0 ? batch->failed : -1;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+void Batch_print_errors(Batch *batch, FILE *out) {
+	int i;
+
+	for (i = 0; i < batch->count; i++) {
+		BatchFile *file = &batch->files[i];
+
+		if (file->tokens < 0 && file->error_line == 0)
+			fprintf(out, "%s: %s\n", file->path, file->error);
+		else if (file->tokens < 0)
+			fprintf(out, "%s:%d:%d: %s\n", file->path, file->error_line, file->error_column, file->error);
+	}
+}
@@ -0,0 +1,57 @@
+#ifndef _MANANA_BATCH_H
+#define _MANANA_BATCH_H
+
+#include "array.h"
+#include "lexer.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Lex many templates on a pool of threads.
+//
+// Files are dealt out largest-first, round-robin, to one queue per worker.
+// A worker takes the largest file left in its own queue and, once that is
+// empty, steals the smallest file left in someone else's, so the big files
+// start early and the small ones fill in the gaps at the end. Each worker
+// lexes into its own Arena, reset between files.
+//
+// Results are kept per file in the order the paths were given, whatever
+// order the files were lexed in, so diagnostics come out the same on any
+// number of threads. Workers print nothing: a file that can't be loaded
+// or lexed gets its error in its BatchFile (error_line 0 if it never got
+// to the lexer), and Batch_print_errors reports them all in path order.
+//
+// If symbols is set, every file's names are interned in it; with more than
+// one thread it has to be a concurrent table. It's borrowed, not freed.
+// If cache is set, files are lexed through their token caches (see
+// cache.h). backend is the lexer every file is lexed with.
+typedef struct BatchFile {
+	const char *path;
+	long size;
+	int tokens;
+	int error_line, error_column;
+	char error[MANANA_ERROR_LENGTH];
+	ArenaStats memory;
+} BatchFile;
+
+typedef struct Batch {
+	BatchFile *files;
+	int count, *order;
+	SymbolTable *symbols;
+	int cache;
+	LexerBackend backend;
+	long bytes, tokens;
+	int failed;
+	double seconds;
+} Batch;
+
+// Called on a worker thread for every file that lexed cleanly, while its
+// token stream is still alive.
+typedef void (*BatchVisit)(Buffer *buf, BatchFile *file, void *ctx);
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+Batch *Batch_create(Array *paths);
+int Batch_run(Batch *batch, int threads, BatchVisit visit, void *ctx);
+void Batch_print_errors(Batch *batch, FILE *out);
+void Batch_destroy(Batch *batch);
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+#endif
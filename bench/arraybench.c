@@ -0,0 +1,147 @@
+// Array benchmark: push/pop churn on Array and on a typed ARRAY_OF array,
+// reporting the cost and the heap (re)allocations per operation.
+//
+//     make bench
+//     bench/arraybench [-n operations]
+//
+// Patterns:
+//   fill      push n elements, then pop them all
+//   churn     fill to a power of two, then push one, pop one, over and over
+//   sawtooth  push 100, pop 100, over and over
+//
+// Every pop is checked against what was pushed; exits 1 on a mismatch.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "array.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static long alloc_count = 0;
+
+void *malloc(size_t size) { alloc_count++; return __libc_malloc(size); }
+void *calloc(size_t n, size_t size) { alloc_count++; return __libc_calloc(n, size); }
+void *realloc(void *ptr, size_t size) { alloc_count++; return __libc_realloc(ptr, size); }
+void free(void *ptr) { __libc_free(ptr); }
+
+ARRAY_OF(IntArray, int)
+
+typedef enum { FILL, CHURN, SAWTOOTH } Pattern;
+
+static const char *const patterns[] = { "fill", "churn", "sawtooth" };
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// The ops the patterns are made of, for either kind of array. Elements
+// are their own index, so a pop knows what it should get back.
+typedef struct Ops {
+	Array *array;
+	IntArray typed;
+	long ops, mismatches;
+} Ops;
+
+static inline void push(Ops *ops) {
+	if (ops->array)
+		Array_push(ops->array, (void *)(intptr_t)Array_count(ops->array));
+	else
+		IntArray_push(&ops->typed, ops->typed.end);
+	ops->ops++;
+}
+
+static inline void pop(Ops *ops) {
+	if (ops->array) {
+		intptr_t expected = Array_count(ops->array) - 1;
+		if ((intptr_t)Array_pop(ops->array) != expected)
+			ops->mismatches++;
+	} else {
+		int expected = ops->typed.end - 1;
+		if (IntArray_pop(&ops->typed) != expected)
+			ops->mismatches++;
+	}
+	ops->ops++;
+}
+
+static inline int count(Ops *ops) {
+	return ops->array ? Array_count(ops->array) : ops->typed.end;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static int bench(Pattern pattern, int typed, long n) {
+	Ops ops = { NULL, { NULL, 0, 0 }, 0, 0 };
+	long i, j;
+
+	if (!typed)
+		ops.array = Array_create(0, 16);
+
+	long allocs = alloc_count;
+	double start = now();
+
+	switch (pattern) {
+	case FILL:
+		for (i = 0; i < n; i++)
+			push(&ops);
+		while (count(&ops) > 0)
+			pop(&ops);
+		break;
+	case CHURN:
+		for (i = 0; i < 1024; i++)
+			push(&ops);
+		for (i = 0; i < n / 2; i++) {
+			push(&ops);
+			pop(&ops);
+		}
+		break;
+	case SAWTOOTH:
+		for (i = 0; i < n / 200; i++) {
+			for (j = 0; j < 100; j++)
+				push(&ops);
+			for (j = 0; j < 100; j++)
+				pop(&ops);
+		}
+		break;
+	}
+
+	double elapsed = now() - start;
+	allocs = alloc_count - allocs;
+
+	printf("%-8s %-9s %9ld ops  %6.2f ns/op  %8.5f allocs/op  %s\n",
+			typed ? "IntArray" : "Array", patterns[pattern], ops.ops,
+			elapsed * 1e9 / ops.ops, (double)allocs / ops.ops,
+			ops.mismatches ? "MISMATCH" : "ok");
+
+	if (typed)
+		IntArray_release(&ops.typed);
+	else
+		Array_destroy(ops.array);
+
+	return ops.mismatches != 0;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+int main(int argc, char *argv[]) {
+	long n = 4000000;
+	int typed, pattern, failed = 0;
+
+	if (argc > 2 && strcmp(argv[1], "-n") == 0)
+		n = atol(argv[2]);
+
+	for (typed = 0; typed < 2; typed++) {
+		for (pattern = FILL; pattern <= SAWTOOTH; pattern++)
+			failed |= bench(pattern, typed, n);
+	}
+
+	return failed;
+}
@@ -0,0 +1,266 @@
+// Token cache benchmark: how long a worker takes to have a template's
+// tokens when it lexes the template and when it loads the token cache
+// saved from lexing it before.
+//
+//     make bench
+//     bench/cachebench [-n iterations] [file ...]
+//
+// Without files it builds a template of a few MB in memory from a snippet
+// with strings, implied values and *keys, which the cache keeps lazy.
+// Before timing, a loaded stream is checked against the lexed one, with
+// and without a SymbolTable, and caches that mustn't be used (source
+// changed, other version, truncated, damaged) are checked to be refused.
+// Exits 1 on any mismatch. The cache goes in $TMPDIR (or /tmp) and is
+// removed afterwards.
+//
+// Loading runs with the cache in the page cache, as it is for a worker
+// that starts on a machine that has seen the template before.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <limits.h>
+#include "lexer.h"
+#include "cache.h"
+#include "source.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static const char *snippet =
+	"html\n"
+	"    head\n"
+	"        title Hello @{page.title} there\n"
+	"    body#main.content(lang=\"en\" *role='x\\'y')\n"
+	"        -if user.age >= 21\n"
+	"            p.greeting Hi @{user.name}\n"
+	"        -for item in items\n"
+	"            li = item.name\n"
+	"        a -> \"https://@{my.domain.name}\"\n"
+	"        .note(title=\"say \\\"hi\\\"\" *id=\"n\") note\n"
+	"        img -> \"pic.png\"\n"
+	"\"\"\"\n"
+	"div not a tag\n"
+	"\"\"\"\n"
+	":text\n"
+	"    top level block\n"
+	"div done\n";
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static uint64_t fnv(uint64_t h, const void *data, size_t size) {
+	const unsigned char *p = data;
+	while (size--)
+		h = (h ^ *p++) * 0x100000001b3ULL;
+	return h;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Hash everything a consumer could observe of buf's tokens. Symbols
+// differ with the table, so only check each one names the token's value.
+static uint64_t stream_hash(Buffer *buf, int count) {
+	uint64_t h = fnv(0xcbf29ce484222325ULL, &count, sizeof(count));
+
+	TOKENS_EACH(buf->stream, tok) {
+		int fields[4] = { tok.type, tok.offset, tok.length, tok.line };
+		h = fnv(h, fields, sizeof(fields));
+		h = fnv(h, Token_value(&tok, buf->src), tok.length);
+
+		if (buf->symbols && Token_has_symbol(tok.type)) {
+			int length, same;
+			const char *name = SymbolTable_name(buf->symbols, tok.symbol, &length);
+
+			same = name && length == tok.length && memcmp(name, Token_value(&tok, buf->src), length) == 0;
+			h = fnv(h, &same, sizeof(same));
+		}
+	}
+
+	return h;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Lex src, or load it from the cache at path if path is set. Returns the
+// stream's hash, or 0 if there was no stream to hash.
+static uint64_t run(char *src, long size, SymbolTable *symbols, const char *path) {
+	Buffer *buf = Buffer_create(src, size);
+	if (buf == NULL)
+		return 0;
+
+	buf->symbols = symbols;
+	int count = path ? TokenCache_load(buf, path) : tokenize(buf);
+	uint64_t h = count < 0 ? 0 : stream_hash(buf, count);
+
+	Buffer_destroy(buf);
+	return h;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Lex src and save its cache at path.
+static int save(char *src, long size, const char *path) {
+	Buffer *buf = Buffer_create(src, size);
+	if (buf == NULL)
+		return -1;
+
+	int rc = tokenize(buf) < 0 ? -1 : TokenCache_save(buf, path);
+
+	Buffer_destroy(buf);
+	return rc;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Overwrite size bytes of the file at path at offset, or cut it short
+// there if data is NULL.
+static int damage(const char *path, long offset, const void *data, size_t size) {
+	if (data == NULL)
+		return truncate(path, offset);
+
+	FILE *f = fopen(path, "r+b");
+	if (f == NULL)
+		return -1;
+
+	fseek(f, offset, SEEK_SET);
+	fwrite(data, size, 1, f);
+	return fclose(f);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Caches that don't fit the source, or can't be read, must be refused.
+static int check_refused(char *src, long size, const char *path) {
+	static const uint32_t version = TOKEN_CACHE_VERSION + 1;
+	static const uint8_t bad_type = 0xff;
+	int failures = 0;
+
+	char *changed = malloc(size + SOURCE_PADDING);
+	if (changed == NULL)
+		return 1;
+	memcpy(changed, src, size + SOURCE_PADDING);
+	changed[size / 2] = changed[size / 2] == 'x' ? 'y' : 'x';
+
+	failures += save(src, size, path) != 0 || run(changed, size, NULL, path) != 0;
+
+	failures += save(src, size, path) != 0 ||
+		damage(path, offsetof(TokenCacheHeader, version), &version, sizeof(version)) != 0 ||
+		run(src, size, NULL, path) != 0;
+
+	failures += save(src, size, path) != 0 ||
+		damage(path, sizeof(TokenCacheHeader) + sizeof(TokenChunk) / 2, NULL, 0) != 0 ||
+		run(src, size, NULL, path) != 0;
+
+	failures += save(src, size, path) != 0 ||
+		damage(path, sizeof(TokenCacheHeader) + 10, &bad_type, sizeof(bad_type)) != 0 ||
+		run(src, size, NULL, path) != 0;
+
+	free(changed);
+	return failures;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static int bench(const char *name, char *src, long size, const char *path, int iterations) {
+	SymbolTable *tables[2] = { SymbolTable_create(0), SymbolTable_create(0) };
+	int i, failed = 0;
+
+	if (tables[0] == NULL || tables[1] == NULL || save(src, size, path) != 0) {
+		SymbolTable_destroy(tables[0]);
+		SymbolTable_destroy(tables[1]);
+		return 1;
+	}
+
+	// Loaded into a different table than it was lexed with, so the
+	// symbols are new ones.
+	int ok = run(src, size, NULL, path) == run(src, size, NULL, NULL) &&
+		run(src, size, tables[1], path) == run(src, size, tables[0], NULL);
+	int refused = check_refused(src, size, path);
+
+	printf("%s: %ld bytes, loaded stream %s, %d bad caches used\n",
+			name, size, ok ? "ok" : "MISMATCH", refused);
+	failed = !ok || refused;
+
+	// Time until the tokens are there to be read, nothing more.
+	double lexed = 1e9, loaded = 1e9;
+	save(src, size, path);
+
+	for (i = 0; i < iterations; i++) {
+		double start = now();
+		Buffer *buf = Buffer_create(src, size);
+		int count = buf ? tokenize(buf) : -1;
+		double elapsed = now() - start;
+
+		if (elapsed < lexed)
+			lexed = elapsed;
+		failed |= count < 0;
+		if (buf)
+			Buffer_destroy(buf);
+
+		start = now();
+		buf = Buffer_create(src, size);
+		count = buf ? TokenCache_load(buf, path) : -1;
+		elapsed = now() - start;
+
+		if (elapsed < loaded)
+			loaded = elapsed;
+		failed |= count < 0;
+		if (buf)
+			Buffer_destroy(buf);
+	}
+
+	double start = now();
+	volatile uint64_t h = TokenCache_hash(src, size);
+	double hashed = now() - start;
+	(void)h;
+
+	printf("  tokenize %9.3f ms\n", lexed * 1000);
+	printf("  load     %9.3f ms  %6.1fx  (hash %.3f ms)\n", loaded * 1000, lexed / loaded, hashed * 1000);
+
+	unlink(path);
+	SymbolTable_destroy(tables[0]);
+	SymbolTable_destroy(tables[1]);
+	return failed;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+int main(int argc, char *argv[]) {
+	const char *tmp = getenv("TMPDIR");
+	char path[PATH_MAX];
+	int iterations = 5;
+	int i, files = 0, failed = 0;
+
+	snprintf(path, sizeof(path), "%s/cachebench-%d%s", tmp ? tmp : "/tmp", (int)getpid(), TOKEN_CACHE_SUFFIX);
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			iterations = atoi(argv[++i]);
+		} else {
+			Source *source = Source_open(argv[i]);
+			if (source == NULL) {
+				log_err("Can't load %s", argv[i]);
+				failed = 1;
+				continue;
+			}
+			failed |= bench(argv[i], source->data, source->size, path, iterations);
+			Source_close(source);
+			files++;
+		}
+	}
+
+	if (files == 0) {
+		long snippet_size = strlen(snippet), size = 0;
+		long copies = 4 * 1024 * 1024 / snippet_size;
+		char *src = calloc(copies * snippet_size + SOURCE_PADDING, 1);
+
+		for (i = 0; i < copies; i++, size += snippet_size)
+			memcpy(src + size, snippet, snippet_size);
+
+		failed |= bench("generated", src, size, path, iterations);
+		free(src);
+	}
+
+	return failed ? 1 : 0;
+}
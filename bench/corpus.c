@@ -0,0 +1,528 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "corpus.h"
+#include "source.h"
+#include "debug.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+typedef enum LineKind {
+	LINE_TAG, LINE_LOGIC, LINE_NAMES, LINE_STRINGS, LINE_COMMENT, LINE_FILTER,
+	LINE_KIND_COUNT
+} LineKind;
+
+typedef struct Mix {
+	const char *name;
+	int weights[LINE_KIND_COUNT];
+	int depth;
+} Mix;
+
+#define CORPUS_MIX_ENTRY(name, tags, logic, names, strings, comments, filters, depth)\
+	{ #name, { tags, logic, names, strings, comments, filters }, depth },
+
+static const Mix mixes[] = {
+	CORPUS_MIXES(CORPUS_MIX_ENTRY)
+};
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static const char *const tags[] = {
+	"div", "span", "p", "a", "li", "ul", "section", "article", "header", "footer",
+	"nav", "img", "h1", "h2", "h3", "table", "tr", "td", "form", "input", "button",
+	"label", "strong", "em", "small", "blockquote", "figure", "main", "aside",
+};
+
+static const char *const words[] = {
+	"the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog", "welcome",
+	"back", "your", "order", "has", "shipped", "and", "will", "arrive", "soon",
+	"read", "more", "about", "our", "latest", "news", "sign", "in", "to",
+	"continue", "price", "total", "items", "cart", "checkout", "now", "free",
+	"delivery", "on", "all", "orders", "contact", "us", "today", "page",
+};
+
+static const char *const classes[] = {
+	"container", "row", "col-md-6", "btn", "btn-primary", "nav_item", "active",
+	"card", "card-body", "text-muted", "hidden", "pull-right", "x1", "is-open",
+};
+
+static const char *const names[] = {
+	"user", "page", "item", "site", "post", "comment", "order", "product",
+	"author", "config", "session", "query", "theme", "menu", "entry",
+};
+
+static const char *const members[] = {
+	"name", "title", "id", "url", "slug", "price", "count", "body", "email",
+	"created", "tags", "items", "author", "first", "last", "domain", "label",
+};
+
+static const char *const attributes[] = {
+	"href", "title", "alt", "type", "name", "value", "placeholder", "class",
+	"id", "role", "aria-label", "tabindex", "target", "rel", "for",
+};
+
+static const char *const filters[] = { "text", "markdown", "javascript", "css", "plain" };
+
+static const char *const comparisons[] = { "==", "!=", ">", ">=", "<", "<=" };
+
+static const char *const types[] = { "String", "Int", "Number", "Boolean", "List", "Hash" };
+
+#define COUNT(A) (int)(sizeof(A) / sizeof((A)[0]))
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+typedef struct Generator {
+	char *data;
+	long size, max;
+	uint64_t state;
+	const Mix *mix;
+	int depth;
+} Generator;
+
+// splitmix64: the same sequence from a seed everywhere, unlike rand().
+static uint64_t gen_next(Generator *g) {
+	uint64_t z = (g->state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+static int gen_rand(Generator *g, int n) {
+	return (int)(gen_next(g) % (uint64_t)n);
+}
+
+#define gen_pick(G, A) ((A)[gen_rand((G), COUNT(A))])
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static int gen_grow(Generator *g, long need) {
+	if (g->size + need + SOURCE_PADDING <= g->max)
+		return 0;
+
+	long max = g->max ? g->max : 4096;
+	while (g->size + need + SOURCE_PADDING > max)
+		max *= 2;
+
+	char *data = realloc(g->data, max);
+	if (data == NULL)
+		return -1;
+
+	g->data = data;
+	g->max = max;
+	return 0;
+}
+
+// Room is made for a whole line before it's written (see gen_line).
+static void gen_putn(Generator *g, const char *s, long length) {
+	memcpy(g->data + g->size, s, length);
+	g->size += length;
+}
+
+static void gen_put(Generator *g, const char *s) {
+	gen_putn(g, s, strlen(s));
+}
+
+static void gen_char(Generator *g, char c) {
+	g->data[g->size++] = c;
+}
+
+static void gen_indent(Generator *g, int depth) {
+	memset(g->data + g->size, ' ', depth * 4);
+	g->size += depth * 4;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// user.name, items[3].title, config[theme].label
+static void gen_name(Generator *g) {
+	int parts = 1 + gen_rand(g, 3);
+
+	gen_put(g, gen_pick(g, names));
+
+	while (parts--) {
+		switch (gen_rand(g, 5)) {
+		case 0:
+			gen_char(g, '[');
+			gen_char(g, '0' + gen_rand(g, 10));
+			gen_char(g, ']');
+			break;
+		case 1:
+			gen_char(g, '[');
+			gen_put(g, gen_pick(g, members));
+			gen_char(g, ']');
+			break;
+		default:
+			gen_char(g, '.');
+			gen_put(g, gen_pick(g, members));
+			break;
+		}
+	}
+}
+
+// Words, with an @{name} among them one time in interpolate.
+static void gen_text(Generator *g, int count, int interpolate) {
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (i > 0)
+			gen_char(g, ' ');
+
+		if (interpolate && gen_rand(g, interpolate) == 0) {
+			gen_put(g, "@{");
+			gen_name(g);
+			gen_char(g, '}');
+		} else {
+			gen_put(g, gen_pick(g, words));
+		}
+	}
+
+	if (gen_rand(g, 4) == 0)
+		gen_char(g, ".,!?"[gen_rand(g, 4)]);
+}
+
+// A string's contents, with escaped quotes and interpolated names.
+static void gen_string(Generator *g, char quote, int lines) {
+	int i, count = 1 + gen_rand(g, 5);
+
+	gen_char(g, quote);
+
+	for (i = 0; i < count; i++) {
+		if (i > 0)
+			gen_char(g, lines && gen_rand(g, 8) == 0 ? '\n' : ' ');
+
+		switch (gen_rand(g, 6)) {
+		case 0:
+			gen_put(g, "@{");
+			gen_name(g);
+			gen_char(g, '}');
+			break;
+		case 1:
+			gen_char(g, '\\');
+			gen_char(g, quote);
+			gen_put(g, gen_pick(g, words));
+			gen_char(g, '\\');
+			gen_char(g, quote);
+			break;
+		default:
+			gen_put(g, gen_pick(g, words));
+			break;
+		}
+	}
+
+	gen_char(g, quote);
+}
+
+// (href="..." *id='...' title="...")
+static void gen_attributes(Generator *g, int count, int lines) {
+	int i;
+
+	gen_char(g, '(');
+
+	for (i = 0; i < count; i++) {
+		if (i > 0)
+			gen_char(g, ' ');
+		if (gen_rand(g, 4) == 0)
+			gen_char(g, '*');
+
+		gen_put(g, gen_pick(g, attributes));
+		gen_char(g, '=');
+		gen_string(g, gen_rand(g, 3) ? '"' : '\'', lines);
+	}
+
+	gen_char(g, ')');
+}
+
+// Tag, or div shorthand, with its #id and .classes.
+static void gen_tag(Generator *g) {
+	int i, count = gen_rand(g, 4);
+
+	if (count == 0 || gen_rand(g, 3))
+		gen_put(g, gen_pick(g, tags));
+	if (gen_rand(g, 5) == 0) {
+		gen_char(g, '#');
+		gen_put(g, gen_pick(g, names));
+	}
+	for (i = 0; i < count; i++) {
+		gen_char(g, '.');
+		gen_put(g, gen_pick(g, classes));
+	}
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static void gen_tag_line(Generator *g) {
+	gen_tag(g);
+
+	if (gen_rand(g, 4) == 0)
+		gen_attributes(g, 1 + gen_rand(g, 2), 0);
+
+	switch (gen_rand(g, 8)) {
+	case 0:
+	case 1:
+	case 2:
+	case 3:
+		gen_char(g, ' ');
+		gen_text(g, 1 + gen_rand(g, 8), 0);
+		break;
+	case 4:
+		gen_put(g, " -> ");
+		gen_string(g, '"', 0);
+		break;
+	default:
+		break;
+	}
+}
+
+static void gen_condition(Generator *g) {
+	switch (gen_rand(g, 7)) {
+	case 0:
+		gen_put(g, "exists ");
+		gen_name(g);
+		break;
+	case 1:
+		gen_put(g, "not ");
+		gen_name(g);
+		break;
+	case 2:
+		gen_name(g);
+		gen_put(g, " is ");
+		gen_put(g, gen_pick(g, types));
+		break;
+	case 3:
+		gen_name(g);
+		gen_put(g, " in ");
+		gen_name(g);
+		break;
+	case 4:
+		gen_name(g);
+		gen_put(g, " % 2 == 0");
+		break;
+	case 5:
+		gen_name(g);
+		gen_char(g, ' ');
+		gen_put(g, gen_pick(g, comparisons));
+		gen_char(g, ' ');
+		gen_name(g);
+		break;
+	default:
+		gen_name(g);
+		gen_char(g, ' ');
+		gen_put(g, gen_pick(g, comparisons));
+		gen_char(g, ' ');
+		gen_char(g, '1' + gen_rand(g, 9));
+		gen_char(g, '0' + gen_rand(g, 10));
+		break;
+	}
+}
+
+static void gen_logic_line(Generator *g) {
+	switch (gen_rand(g, 8)) {
+	case 0:
+	case 1:
+	case 2:
+		gen_put(g, "-if ");
+		gen_condition(g);
+		break;
+	case 3:
+		gen_put(g, "-elif ");
+		gen_condition(g);
+		break;
+	case 4:
+		gen_put(g, "-else");
+		break;
+	case 5:
+		gen_put(g, "-for ");
+		gen_put(g, gen_pick(g, names));
+		gen_put(g, " in ");
+		gen_name(g);
+		break;
+	case 6:
+		gen_put(g, "-each ");
+		gen_name(g);
+		break;
+	default:
+		gen_put(g, "-alias ");
+		gen_name(g);
+		gen_put(g, " as ");
+		gen_put(g, gen_pick(g, names));
+		break;
+	}
+}
+
+static void gen_names_line(Generator *g) {
+	switch (gen_rand(g, 4)) {
+	case 0:
+		gen_put(g, gen_pick(g, tags));
+		gen_put(g, " = ");
+		gen_name(g);
+		break;
+	case 1:
+		gen_put(g, "a -> \"https://@{");
+		gen_name(g);
+		gen_put(g, "}/@{");
+		gen_name(g);
+		gen_put(g, "}\"");
+		break;
+	default:
+		gen_tag(g);
+		gen_char(g, ' ');
+		gen_text(g, 2 + gen_rand(g, 8), 2);
+		break;
+	}
+}
+
+static void gen_strings_line(Generator *g) {
+	gen_tag(g);
+	gen_attributes(g, 1 + gen_rand(g, 4), 1);
+
+	if (gen_rand(g, 2)) {
+		gen_char(g, ' ');
+		gen_text(g, 1 + gen_rand(g, 4), 0);
+	}
+}
+
+// Comments can hold anything but """, templates included.
+static void gen_comment(Generator *g) {
+	int i, count = gen_rand(g, 6);
+
+	gen_put(g, "\"\"\"");
+
+	for (i = 0; i < count; i++) {
+		gen_char(g, '\n');
+		gen_indent(g, gen_rand(g, 3));
+
+		if (gen_rand(g, 2))
+			gen_tag_line(g);
+		else
+			gen_text(g, 1 + gen_rand(g, 10), 0);
+	}
+
+	gen_char(g, '\n');
+	gen_indent(g, g->depth);
+	gen_put(g, "\"\"\"");
+}
+
+// A block's lines are one level deeper than the filter, some further in.
+// It ends at the first line that isn't, so it can't have blank lines.
+static void gen_filter(Generator *g) {
+	int i, count = 1 + gen_rand(g, 8);
+
+	gen_char(g, ':');
+	gen_put(g, gen_pick(g, filters));
+
+	if (gen_rand(g, 3) == 0) {
+		gen_char(g, ' ');
+		gen_text(g, 1 + gen_rand(g, 6), 3);
+		return;
+	}
+
+	for (i = 0; i < count; i++) {
+		gen_char(g, '\n');
+		gen_indent(g, g->depth + 1 + (i > 0 && gen_rand(g, 4) == 0));
+		gen_text(g, 1 + gen_rand(g, 10), 4);
+	}
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static LineKind gen_kind(Generator *g) {
+	int total = 0, i;
+
+	for (i = 0; i < LINE_KIND_COUNT; i++)
+		total += g->mix->weights[i];
+
+	int r = gen_rand(g, total);
+	for (i = 0; r >= g->mix->weights[i]; i++)
+		r -= g->mix->weights[i];
+
+	return i;
+}
+
+// Longest a line gets: a comment or filter block of the most lines, each
+// as long as a strings line, all at the deepest indent.
+#define LINE_MAX (16 * (1024 + 4 * 128))
+
+static int gen_line(Generator *g) {
+	LineKind kind = gen_kind(g);
+	int max = g->mix->depth;
+
+	if (gen_grow(g, LINE_MAX) != 0)
+		return -1;
+
+	gen_indent(g, g->depth);
+
+	switch (kind) {
+	case LINE_TAG:     gen_tag_line(g);     break;
+	case LINE_LOGIC:   gen_logic_line(g);   break;
+	case LINE_NAMES:   gen_names_line(g);   break;
+	case LINE_STRINGS: gen_strings_line(g); break;
+	case LINE_COMMENT: gen_comment(g);      break;
+	case LINE_FILTER:  gen_filter(g);       break;
+	default:                                break;
+	}
+
+	gen_char(g, '\n');
+
+	// Tags and logic open blocks. Deep mixes dedent one level at a time,
+	// so they stay deep, and every so often go back to the top.
+	if ((kind == LINE_TAG || kind == LINE_LOGIC) && g->depth < max && gen_rand(g, 100) < 45)
+		g->depth++;
+	else if (kind != LINE_FILTER && gen_rand(g, 100) < (max > 16 ? 30 : 40))
+		g->depth -= 1 + gen_rand(g, max > 16 ? 1 : 3);
+
+	if (g->depth < 0 || gen_rand(g, 1000) < 5)
+		g->depth = 0;
+
+	return 0;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+const char *Corpus_mix_name(CorpusMix mix) {
+	return mix >= 0 && mix < CORPUS_MIX_COUNT ? mixes[mix].name : NULL;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Returns the mix called name, or -1.
+int Corpus_mix_find(const char *name) {
+	int i;
+
+	for (i = 0; i < CORPUS_MIX_COUNT; i++) {
+		if (strcmp(mixes[i].name, name) == 0)
+			return i;
+	}
+
+	return -1;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// A template of at least size bytes, whole lines of it, followed by
+// SOURCE_PADDING zero bytes like a Source. Its size goes in *generated.
+// Returns NULL if there's no memory; free it with free.
+char *Corpus_generate(CorpusMix mix, long size, uint64_t seed, long *generated) {
+	Generator g = { NULL, 0, 0, seed, NULL, 0 };
+
+	check(mix >= 0 && mix < CORPUS_MIX_COUNT, "No corpus mix %d.", mix);
+	g.mix = &mixes[mix];
+
+	while (g.size < size) {
+		check_mem(gen_line(&g) == 0);
+	}
+
+	check_mem(gen_grow(&g, 0) == 0);
+	memset(g.data + g.size, 0, SOURCE_PADDING);
+
+	*generated = g.size;
+	return g.data;
+error:
+	free(g.data);
+	return NULL;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// "4096", "64K", "16M", "1G". Returns -1 if it isn't a size.
+long Corpus_parse_size(const char *text) {
+	char *end;
+	long size = strtol(text, &end, 10);
+
+	switch (*end) {
+	case 'k': case 'K': size <<= 10; end++; break;
+	case 'm': case 'M': size <<= 20; end++; break;
+	case 'g': case 'G': size <<= 30; end++; break;
+	default:                                break;
+	}
+
+	return end == text || *end != '\0' || size < 0 ? -1 : size;
+}
@@ -0,0 +1,39 @@
+#ifndef _MANANA_CORPUS_H
+#define _MANANA_CORPUS_H
+
+#include <stdint.h>
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Synthetic templates for the benchmarks. A mix weighs the kinds of line
+// the generator writes, so each one keeps a different set of lexer states
+// busy; "mixed" is a plausible page. The same mix, size and seed always
+// give the same bytes, on any machine, so results can be compared over
+// time. Everything generated lexes without errors, so no mix nests deeper
+// than the default MAX_INDENT (16) allows.
+//
+//     name      tags logic names strings comments filters depth
+#define CORPUS_MIXES(X)\
+	X(mixed,      40,   15,   15,     15,       5,      10,   12)\
+	X(tags,       90,    0,    5,      5,       0,       0,    8)\
+	X(logic,      20,   70,   10,      0,       0,       0,   12)\
+	X(names,      15,    5,   75,      5,       0,       0,    8)\
+	X(strings,    10,    0,   10,     80,       0,       0,    8)\
+	X(comments,   20,    0,    0,      0,      80,       0,    4)\
+	X(filters,    20,    0,    0,      0,       0,      80,    8)\
+	X(nested,     60,   30,    5,      5,       0,       0,   14)
+
+#define CORPUS_MIX_ENUM(name, ...) MIX_##name,
+
+typedef enum CorpusMix {
+	CORPUS_MIXES(CORPUS_MIX_ENUM)
+	CORPUS_MIX_COUNT
+} CorpusMix;
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+const char *Corpus_mix_name(CorpusMix mix);
+int Corpus_mix_find(const char *name);
+char *Corpus_generate(CorpusMix mix, long size, uint64_t seed, long *generated);
+long Corpus_parse_size(const char *text);
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+#endif
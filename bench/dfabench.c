@@ -0,0 +1,89 @@
+// Benchmark of the two lexers: the states in lexer.c and the DFA generated
+// from lexer.grammar (see dfa.h). That they give the same streams is
+// checked by test/dfatest.
+//
+//     make bench
+//     bench/dfabench [-s size]
+//
+// Every mix in corpus.h, size bytes each (1M by default, K, M and G
+// suffixes taken), is timed with both, and the DFA's speed is given
+// relative to the hand-written lexer's.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "lexer.h"
+#include "corpus.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Seconds it takes backend to tokenize src times times, the best of three.
+static double time_lex(char *src, long size, LexerBackend backend, int times) {
+	double best = 0;
+	int round, i;
+
+	for (round = 0; round < 3; round++) {
+		double start = now();
+
+		for (i = 0; i < times; i++) {
+			Buffer *buf = Buffer_create(src, size);
+			check_mem(buf);
+			buf->backend = backend;
+			check(tokenize(buf) >= 0, "Doesn't lex with %s: %s", Lexer_backend_name(backend), buf->error_message);
+			Buffer_destroy(buf);
+		}
+
+		double elapsed = now() - start;
+		if (round == 0 || elapsed < best)
+			best = elapsed;
+	}
+
+	return best;
+error:
+	return -1;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+int main(int argc, char *argv[]) {
+	long size = 1 << 20;
+	double hand_total = 0, dfa_total = 0;
+	int i, mix;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			size = Corpus_parse_size(argv[++i]);
+			check(size > 0, "Bad size %s", argv[i]);
+		}
+	}
+
+	for (mix = 0; mix < CORPUS_MIX_COUNT; mix++) {
+		long generated;
+		char *src = Corpus_generate(mix, size, 1, &generated);
+		check_mem(src);
+
+		int times = (32L << 20) / generated > 0 ? (32L << 20) / generated : 1;
+		double hand = time_lex(src, generated, LEXER_HAND, times);
+		double dfa = time_lex(src, generated, LEXER_DFA, times);
+		double mb = (double)generated * times / (1024 * 1024);
+		free(src);
+		check(hand > 0 && dfa > 0, "%s doesn't lex.", Corpus_mix_name(mix));
+
+		printf("%-10s %9ld bytes   hand %8.2f MB/s   dfa %8.2f MB/s   %5.2fx\n",
+				Corpus_mix_name(mix), generated, mb / hand, mb / dfa, hand / dfa);
+		hand_total += hand;
+		dfa_total += dfa;
+	}
+
+	printf("all mixes: the DFA runs at %.2fx the hand-written lexer's speed\n", hand_total / dfa_total);
+
+	return 0;
+error:
+	return 1;
+}
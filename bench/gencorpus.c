@@ -0,0 +1,74 @@
+// Corpus generator: writes one of the synthetic templates lexbench
+// benchmarks (see corpus.h) to a file, to lex it with anything else.
+//
+//     make bench
+//     bench/gencorpus [-m mix] [-s size] [-S seed] [file]
+//
+// size takes K, M and G suffixes and defaults to 1M; the file is cut at
+// the first line end at or after it. Without a file it goes to stdout.
+// The same arguments always write the same bytes.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "corpus.h"
+#include "debug.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static void usage() {
+	int i;
+
+	fprintf(stderr, "usage: bench/gencorpus [-m mix] [-s size] [-S seed] [file]\n");
+	fprintf(stderr, "mixes:");
+	for (i = 0; i < CORPUS_MIX_COUNT; i++)
+		fprintf(stderr, " %s", Corpus_mix_name(i));
+	fprintf(stderr, "\n");
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+int main(int argc, char *argv[]) {
+	int mix = MIX_mixed;
+	long size = 1 << 20, generated;
+	uint64_t seed = 1;
+	const char *path = NULL;
+	FILE *out = stdout;
+	char *src = NULL;
+	int i;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+			mix = Corpus_mix_find(argv[++i]);
+		} else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			size = Corpus_parse_size(argv[++i]);
+		} else if (strcmp(argv[i], "-S") == 0 && i + 1 < argc) {
+			seed = strtoull(argv[++i], NULL, 10);
+		} else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+			usage();
+			return 1;
+		} else {
+			path = argv[i];
+		}
+	}
+
+	if (mix < 0 || size < 0) {
+		usage();
+		return 1;
+	}
+
+	src = Corpus_generate(mix, size, seed, &generated);
+	check_mem(src);
+
+	if (path && strcmp(path, "-") != 0) {
+		out = fopen(path, "wb");
+		check(out, "Can't open %s", path);
+	}
+
+	check(fwrite(src, 1, generated, out) == (size_t)generated, "Can't write %s", path ? path : "stdout");
+	check(out == stdout || fclose(out) == 0, "Can't write %s", path);
+
+	free(src);
+	return 0;
+error:
+	free(src);
+	return 1;
+}
@@ -0,0 +1,121 @@
+// Indentation benchmark: lexes generated templates that nest deeply and
+// dedent quickly, and reports the cost and heap allocations per line.
+//
+//     make bench
+//     bench/indentbench [-n iterations]
+//
+// Shapes:
+//   flat     every line at column 0, the baseline
+//   stairs   indent one level per line to depth 12, dedent one per line
+//   cliff    indent to depth 40, then dedent to column 0 in one line
+//   deep     indent to depth 120, then dedent to column 0 in one line
+//
+// The last two nest deeper than the default MAX_INDENT, so their Buffers'
+// limit is raised to fit.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "lexer.h"
+#include "source.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static long alloc_count = 0;
+
+void *malloc(size_t size) { alloc_count++; return __libc_malloc(size); }
+void *calloc(size_t n, size_t size) { alloc_count++; return __libc_calloc(n, size); }
+void *realloc(void *ptr, size_t size) { alloc_count++; return __libc_realloc(ptr, size); }
+void free(void *ptr) { __libc_free(ptr); }
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Append a "div" line at depth levels of two spaces.
+static long add_line(char *src, long size, int depth) {
+	memset(src + size, ' ', depth * 2);
+	size += depth * 2;
+	memcpy(src + size, "div\n", 4);
+	return size + 4;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Repeat a ramp up to depth until about bytes long. With stairs the ramp
+// also comes back down a level at a time.
+static char *generate(long bytes, int depth, int stairs, long *size, long *lines) {
+	long ramp = 2 * (depth + 1) * (depth * 2 + 4);
+	char *src = calloc(bytes + ramp + SOURCE_PADDING, 1);
+	int d;
+
+	*size = *lines = 0;
+	while (*size < bytes) {
+		for (d = 0; d <= depth; d++, (*lines)++)
+			*size = add_line(src, *size, d);
+		for (d = depth - 1; stairs && d > 0; d--, (*lines)++)
+			*size = add_line(src, *size, d);
+	}
+
+	return src;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static void bench(const char *name, int depth, int stairs, int iterations) {
+	long size, lines, tokens = 0;
+	char *src = generate(256 * 1024, depth, stairs, &size, &lines);
+	int i;
+
+	long allocs = alloc_count;
+	double start = now();
+
+	for (i = 0; i < iterations; i++) {
+		Buffer *buf = Buffer_create(src, size);
+		IndentStack_set_limit(&buf->indent_stack, depth + 1);
+		int count = tokenize(buf);
+
+		if (count < 0) {
+			printf("%s: %s\n", name, buf->error_message);
+			Buffer_destroy(buf);
+			free(src);
+			return;
+		}
+
+		tokens += count;
+		Buffer_destroy(buf);
+	}
+
+	double elapsed = now() - start;
+	allocs = alloc_count - allocs;
+
+	printf("%-8s depth %3d  %7ld lines  %8.1f ns/line  %6.3f allocs/line  %8.2f MB/s\n",
+			name, depth, lines,
+			elapsed * 1e9 / ((double)lines * iterations),
+			(double)allocs / ((double)lines * iterations),
+			(double)size * iterations / elapsed / (1024 * 1024));
+
+	free(src);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+int main(int argc, char *argv[]) {
+	int iterations = 20;
+
+	if (argc > 2 && strcmp(argv[1], "-n") == 0)
+		iterations = atoi(argv[2]);
+
+	bench("flat", 0, 0, iterations);
+	bench("stairs", 12, 1, iterations);
+	bench("cliff", 40, 0, iterations);
+	bench("deep", 120, 0, iterations);
+
+	return 0;
+}
@@ -0,0 +1,341 @@
+// Lexer benchmark: lexes each input repeatedly and reports throughput,
+// how many heap allocations the lexer makes per token, how many bytes of
+// arena each token takes, the token stream included, and peak RSS.
+//
+//     make bench
+//     bench/lexbench [-n iterations] [-s size] [-m mix] [-S seed] [--perf] [--json] [file ...]
+//
+// Without files it lexes the examples and one generated template of each
+// mix in corpus.h (or only -m's), size bytes each (1M by default, K, M
+// and G suffixes taken). Generated templates are lexed enough times to
+// add up to 64 MB unless -n says otherwise; files 10000 times.
+//
+// Allocations are counted by interposing the malloc family, so the numbers
+// include everything the lexer calls into (sds, Array, strdup, ...). Peak
+// RSS is reset before each input where Linux allows it, and includes the
+// input itself. --json prints one object for all of it, to keep results
+// from run to run; exits 1 if any input doesn't lex.
+//
+// --perf also counts cycles, instructions, branch and cache misses (see
+// perf.h) per KB of input, around tokenize and around reading the stream
+// back the way a parser does, which builds the line index and expands
+// lazy values (task_clock counts ns). Reading isn't in the other numbers.
+// Counters the machine doesn't have are left out.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "lexer.h"
+#include "source.h"
+#include "corpus.h"
+#include "perf.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static long alloc_count = 0;
+
+void *malloc(size_t size) { alloc_count++; return __libc_malloc(size); }
+void *calloc(size_t n, size_t size) { alloc_count++; return __libc_calloc(n, size); }
+void *realloc(void *ptr, size_t size) { alloc_count++; return __libc_realloc(ptr, size); }
+void free(void *ptr) { __libc_free(ptr); }
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+typedef enum Stage { STAGE_TOKENIZE, STAGE_READ, STAGE_COUNT } Stage;
+
+static const char *const stages[] = { "tokenize", "read" };
+
+typedef struct Result {
+	const char *name, *kind;
+	long size, tokens, allocs, peak_rss;
+	int iterations;
+	double elapsed;
+	ArenaStats memory;
+	PerfCounts perf[STAGE_COUNT];
+} Result;
+
+static PerfCounters perf;
+static int use_perf = 0;
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Writing 5 to clear_refs resets VmHWM to the current RSS (Linux 4.0+).
+static void peak_rss_reset() {
+	FILE *f = fopen("/proc/self/clear_refs", "w");
+	if (f) {
+		fputs("5", f);
+		fclose(f);
+	}
+}
+
+// Peak RSS in KB since the last reset, or since the start without one.
+static long peak_rss() {
+	FILE *f = fopen("/proc/self/status", "r");
+	char line[256];
+	long kb = -1;
+
+	if (f) {
+		while (fgets(line, sizeof(line), f)) {
+			if (strncmp(line, "VmHWM:", 6) == 0)
+				kb = atol(line + 6);
+		}
+		fclose(f);
+	}
+
+	if (kb < 0) {
+		struct rusage usage;
+		kb = getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss : 0;
+	}
+
+	return kb;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Every token's value and line, as a parser would read them.
+static long read_stream(Buffer *buf) {
+	long sum = 0;
+
+	TOKENS_EACH(buf->stream, tok)
+		sum += tok.line + Token_value(&tok, buf->src)[0];
+
+	return sum;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static int bench_src(char *src, long size, int iterations, Result *result) {
+	long tokens = 0, read_allocs = 0;
+	double read_time = 0;
+	volatile long sink = 0;
+	int i;
+
+	peak_rss_reset();
+
+	long allocs = alloc_count;
+	double start = now();
+
+	for (i = 0; i < iterations; i++) {
+		Buffer *buf = Buffer_create(src, size);
+		check_mem(buf);
+
+		if (use_perf)
+			PerfCounters_start(&perf);
+		int count = tokenize(buf);
+		if (use_perf)
+			PerfCounters_stop(&perf, &result->perf[STAGE_TOKENIZE]);
+
+		if (count < 0) {
+			log_err("%s:%d:%d: %s", result->name, buf->error_line, buf->error_column, buf->error_message);
+			Buffer_destroy(buf);
+			return -1;
+		}
+
+		tokens += count;
+		if (i == 0)
+			Arena_stats(buf->arena, &result->memory);
+
+		if (use_perf) {
+			long before = alloc_count;
+			double t = now();
+
+			PerfCounters_start(&perf);
+			sink += read_stream(buf);
+			PerfCounters_stop(&perf, &result->perf[STAGE_READ]);
+
+			read_time += now() - t;
+			read_allocs += alloc_count - before;
+		}
+
+		Buffer_destroy(buf);
+	}
+
+	result->elapsed = now() - start - read_time;
+	result->allocs = alloc_count - allocs - read_allocs;
+	result->peak_rss = peak_rss();
+	result->size = size;
+	result->tokens = tokens;
+	result->iterations = iterations;
+	return 0;
+error:
+	return -1;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static void print_json_string(const char *s) {
+	putchar('"');
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			putchar('\\');
+		putchar(*s);
+	}
+	putchar('"');
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Counts per KB of input for each stage, and IPC.
+static void print_perf(Result *r, int json) {
+	double kb = (double)r->size * r->iterations / 1024;
+	int stage, i;
+
+	if (json)
+		printf(", \"perf\": {");
+
+	for (stage = 0; stage < STAGE_COUNT; stage++) {
+		double *value = r->perf[stage].value;
+		int ipc = value[PERF_cycles] > 0 && value[PERF_instructions] >= 0;
+
+		printf(json ? "%s\"%s\": {" : "%s    %-10s", json && stage ? ", " : "", stages[stage]);
+
+		for (i = 0; i < PERF_COUNTER_COUNT; i++) {
+			if (json && value[i] >= 0)
+				printf("%s\"%s_per_kb\": %.2f", i ? ", " : "", PerfCounter_name(i), value[i] / kb);
+			else if (json)
+				printf("%s\"%s_per_kb\": null", i ? ", " : "", PerfCounter_name(i));
+			else if (value[i] >= 0)
+				printf("  %10.1f %s/KB", value[i] / kb, PerfCounter_name(i));
+		}
+
+		if (json && ipc)
+			printf(", \"ipc\": %.3f}", value[PERF_instructions] / value[PERF_cycles]);
+		else if (json)
+			printf(", \"ipc\": null}");
+		else if (ipc)
+			printf("  %5.2f IPC\n", value[PERF_instructions] / value[PERF_cycles]);
+		else
+			printf("\n");
+	}
+
+	if (json)
+		printf("}");
+}
+
+static void print_result(Result *r, int json, int first) {
+	double tokens = r->tokens > 0 ? r->tokens : 1;
+	double mb_s = (double)r->size * r->iterations / r->elapsed / (1024 * 1024);
+	double tokens_s = r->tokens / r->elapsed;
+	double ns_token = r->elapsed * 1e9 / tokens;
+	double allocs_token = r->allocs / tokens;
+	double bytes_token = (double)r->memory.used * r->iterations / tokens;
+
+	if (!json) {
+		printf("%-32s %10ld bytes %8ld tokens  %6.2f allocs/token  %6.1f bytes/token  %8.2f MB/s  %6.2f Mtokens/s  %7.1f ns/token  %7ld KB peak\n",
+				r->name, r->size, r->tokens / r->iterations, allocs_token, bytes_token,
+				mb_s, tokens_s / 1e6, ns_token, r->peak_rss);
+		if (use_perf)
+			print_perf(r, json);
+		return;
+	}
+
+	printf("%s\n    {\"name\": ", first ? "" : ",");
+	print_json_string(r->name);
+	printf(", \"kind\": \"%s\", \"bytes\": %ld, \"tokens\": %ld, \"iterations\": %d,"
+			" \"mb_per_s\": %.3f, \"tokens_per_s\": %.0f, \"ns_per_token\": %.3f,"
+			" \"allocs_per_token\": %.4f, \"arena_bytes_per_token\": %.2f, \"peak_rss_kb\": %ld",
+			r->kind, r->size, r->tokens / r->iterations, r->iterations,
+			mb_s, tokens_s, ns_token, allocs_token, bytes_token, r->peak_rss);
+	if (use_perf)
+		print_perf(r, json);
+	printf("}");
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+int main(int argc, char *argv[]) {
+	const char *paths[argc + 2];
+	int iterations = 0, json = 0, mix = -1;
+	long size = 1 << 20;
+	uint64_t seed = 1;
+	int i, files = 0, failed = 0, printed = 0;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			iterations = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			size = Corpus_parse_size(argv[++i]);
+			check(size >= 0, "Bad size %s", argv[i]);
+		} else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+			mix = Corpus_mix_find(argv[++i]);
+			check(mix >= 0, "No corpus mix %s", argv[i]);
+		} else if (strcmp(argv[i], "-S") == 0 && i + 1 < argc) {
+			seed = strtoull(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--json") == 0) {
+			json = 1;
+		} else if (strcmp(argv[i], "--perf") == 0) {
+			use_perf = 1;
+		} else {
+			paths[files++] = argv[i];
+		}
+	}
+
+	// Without files or a mix, the examples and every mix.
+	int generate = files == 0 || mix >= 0;
+	if (files == 0 && mix < 0) {
+		paths[files++] = "examples/0.basics.manana";
+		paths[files++] = "bench/page.manana";
+	}
+
+	// Without any counters there's nothing to report but the error.
+	if (use_perf && PerfCounters_open(&perf) == 0) {
+		log_warn("No performance counters: %s", strerror(perf.error));
+		use_perf = 0;
+	}
+
+	if (json) {
+		printf("{\"benchmark\": \"lexbench\", \"seed\": %llu", (unsigned long long)seed);
+		if (perf.error)
+			printf(", \"perf_error\": \"%s\"", strerror(perf.error));
+		printf(", \"results\": [");
+	}
+
+	for (i = 0; i < files; i++) {
+		Source *source = Source_open(paths[i]);
+		if (source == NULL) {
+			log_err("Can't load %s", paths[i]);
+			failed = 1;
+			continue;
+		}
+
+		Result result = { .name = paths[i], .kind = "file" };
+		if (bench_src(source->data, source->size, iterations ? iterations : 10000, &result) == 0)
+			print_result(&result, json, printed++ == 0);
+		else
+			failed = 1;
+		Source_close(source);
+	}
+
+	for (i = 0; generate && i < CORPUS_MIX_COUNT; i++) {
+		if (mix >= 0 && i != mix)
+			continue;
+
+		long generated;
+		char *src = Corpus_generate(i, size, seed, &generated);
+		check_mem(src);
+
+		int times = iterations ? iterations : (int)((64L << 20) / (generated ? generated : 1));
+		Result result = { .name = Corpus_mix_name(i), .kind = "generated" };
+
+		if (bench_src(src, generated, times > 0 ? times : 1, &result) == 0)
+			print_result(&result, json, printed++ == 0);
+		else
+			failed = 1;
+		free(src);
+	}
+
+	if (json)
+		printf("\n]}\n");
+
+	if (use_perf)
+		PerfCounters_close(&perf);
+	return failed;
+error:
+	return 1;
+}
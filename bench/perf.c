@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "perf.h"
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+#define PERF_COUNTER_NAME(name, ...) #name,
+
+static const char *const names[] = {
+	PERF_COUNTERS(PERF_COUNTER_NAME)
+};
+
+const char *PerfCounter_name(PerfCounter counter) {
+	return counter >= 0 && counter < PERF_COUNTER_COUNT ? names[counter] : NULL;
+}
+
+#ifdef __linux__
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+#define PERF_COUNTER_EVENT(name, type, config) { type, config },
+
+static const struct { uint32_t type; uint64_t config; } events[] = {
+	PERF_COUNTERS(PERF_COUNTER_EVENT)
+};
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Opens what it can, disabled. Returns how many counters it opened; if
+// that's none, perf->error is the errno of the last one to fail.
+int PerfCounters_open(PerfCounters *perf) {
+	int i;
+
+	memset(perf, 0, sizeof(PerfCounters));
+
+	for (i = 0; i < PERF_COUNTER_COUNT; i++) {
+		struct perf_event_attr attr;
+
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = events[i].type;
+		attr.config = events[i].config;
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		perf->fd[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+		if (perf->fd[i] < 0)
+			perf->error = errno;
+		else
+			perf->open++;
+	}
+
+	return perf->open;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// value, time enabled, time running
+static int PerfCounters_read(int fd, uint64_t values[3]) {
+	return read(fd, values, 3 * sizeof(uint64_t)) == 3 * sizeof(uint64_t) ? 0 : -1;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+void PerfCounters_start(PerfCounters *perf) {
+	int i;
+
+	for (i = 0; i < PERF_COUNTER_COUNT; i++) {
+		if (perf->fd[i] >= 0 && PerfCounters_read(perf->fd[i], perf->start[i]) == 0)
+			ioctl(perf->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+	}
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Adds what each counter counted since PerfCounters_start to counts.
+void PerfCounters_stop(PerfCounters *perf, PerfCounts *counts) {
+	uint64_t end[3];
+	int i;
+
+	for (i = 0; i < PERF_COUNTER_COUNT; i++) {
+		if (perf->fd[i] < 0) {
+			counts->value[i] = -1;
+			continue;
+		}
+
+		ioctl(perf->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+		if (PerfCounters_read(perf->fd[i], end) != 0)
+			continue;
+
+		double value = end[0] - perf->start[i][0];
+		uint64_t enabled = end[1] - perf->start[i][1];
+		uint64_t running = end[2] - perf->start[i][2];
+
+		if (running > 0 && running < enabled)
+			value *= (double)enabled / running;
+		counts->value[i] += value;
+	}
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+void PerfCounters_close(PerfCounters *perf) {
+	int i;
+
+	for (i = 0; i < PERF_COUNTER_COUNT; i++) {
+		if (perf->fd[i] >= 0)
+			close(perf->fd[i]);
+		perf->fd[i] = -1;
+	}
+
+	perf->open = 0;
+}
+
+#else
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+int PerfCounters_open(PerfCounters *perf) {
+	int i;
+
+	memset(perf, 0, sizeof(PerfCounters));
+	for (i = 0; i < PERF_COUNTER_COUNT; i++)
+		perf->fd[i] = -1;
+
+	perf->error = ENOSYS;
+	return 0;
+}
+
+void PerfCounters_start(PerfCounters *perf) {
+	(void)perf;
+}
+
+void PerfCounters_stop(PerfCounters *perf, PerfCounts *counts) {
+	int i;
+
+	(void)perf;
+	for (i = 0; i < PERF_COUNTER_COUNT; i++)
+		counts->value[i] = -1;
+}
+
+void PerfCounters_close(PerfCounters *perf) {
+	(void)perf;
+}
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef _MANANA_PERF_H
+#define _MANANA_PERF_H
+
+#include <stdint.h>
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Hardware counters for the benchmarks, through perf_event_open(2), for
+// this thread in user space. Each counter is opened on its own, so the
+// ones the machine has work without the rest: containers and VMs often
+// have no hardware counters at all, and kernel.perf_event_paranoid can
+// forbid all of them. A counter that couldn't be opened reads as -1.
+// Counts are scaled up if the kernel had to multiplex the counters.
+//
+//     name           type, config
+#define PERF_COUNTERS(X)\
+	X(task_clock,     PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK)\
+	X(cycles,         PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES)\
+	X(instructions,   PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS)\
+	X(branch_misses,  PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES)\
+	X(l1d_misses,     PERF_TYPE_HW_CACHE, PERF_CACHE_MISS(PERF_COUNT_HW_CACHE_L1D))\
+	X(llc_misses,     PERF_TYPE_HW_CACHE, PERF_CACHE_MISS(PERF_COUNT_HW_CACHE_LL))
+
+#define PERF_CACHE_MISS(CACHE)\
+	((CACHE) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+#define PERF_COUNTER_ENUM(name, ...) PERF_##name,
+
+typedef enum PerfCounter {
+	PERF_COUNTERS(PERF_COUNTER_ENUM)
+	PERF_COUNTER_COUNT
+} PerfCounter;
+
+// Counts added up over every start and stop.
+typedef struct PerfCounts {
+	double value[PERF_COUNTER_COUNT];
+} PerfCounts;
+
+typedef struct PerfCounters {
+	int fd[PERF_COUNTER_COUNT];
+	uint64_t start[PERF_COUNTER_COUNT][3];
+	int open, error;
+} PerfCounters;
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+int PerfCounters_open(PerfCounters *perf);
+void PerfCounters_start(PerfCounters *perf);
+void PerfCounters_stop(PerfCounters *perf, PerfCounts *counts);
+void PerfCounters_close(PerfCounters *perf);
+const char *PerfCounter_name(PerfCounter counter);
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+#endif
@@ -0,0 +1,246 @@
+// Incremental relexing benchmark: applies random edits to a large template
+// one after another, the way an author types into it, and relexes each
+// edit with relex and TokenSplice_apply as well as with tokenize.
+//
+//     make bench
+//     bench/relexbench [-n edits] [file]
+//
+// Without a file it builds a template of a few MB in memory from a snippet
+// with """ comments, :filter blocks and strings across lines, and edits
+// insert and delete pieces of those, so that many of them open or close
+// one and change how far the relexing has to go. Every spliced stream,
+// its resync points and any error are checked against the full lex of
+// the same source; exits 1 on any mismatch. An edit that leaves the
+// template not lexing is undone before the next, as an editor would keep
+// the last good stream.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "lexer.h"
+#include "relex.h"
+#include "source.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static const char *snippet =
+	"html\n"
+	"    head\n"
+	"        title Hello @{page.title} there\n"
+	"    body#main.content(lang=\"en\" *role='x\\'y')\n"
+	"        -if user.age >= 21\n"
+	"            p.greeting Hi @{user.name}\n"
+	"        -for item in items\n"
+	"            li = item.name\n"
+	"        a -> \"https://@{my.domain.name}\"\n"
+	"        :text\n"
+	"            raw text line\n"
+	"              more\n"
+	"        img -> \"pic.png\"\n"
+	"\"\"\"\n"
+	"div not a tag\n"
+	"    inside a comment\n"
+	"\"\"\"\n"
+	"div\n"
+	"    :text\n"
+	"        block\n"
+	"p ends the block on column 0\n"
+	"p(title=\"a string\n"
+	"span across lines\")\n"
+	":text\n"
+	"    top level block\n"
+	"div done\n";
+
+static const char *const pieces[] = {
+	"\n", "    ", "div", "p.x", "#id ", "\"\"\"\n", "\"", "'", ":text\n", "-if a\n",
+	"@{x}", "(a=\"b\")", "(b=\n", ")", "span text", "\n:text\n    t\n", "\n\n", "x",
+};
+
+#define PIECE_COUNT (int)(sizeof(pieces) / sizeof(pieces[0]))
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static uint64_t fnv(uint64_t h, const void *data, size_t size) {
+	const unsigned char *p = data;
+	while (size--)
+		h = (h ^ *p++) * 0x100000001b3ULL;
+	return h;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Everything a consumer could observe of buf's tokens, its resync points
+// and its error. Both Buffers intern into the same table, so even the
+// symbols have to be the same.
+static uint64_t buf_hash(Buffer *buf) {
+	uint64_t h = fnv(0xcbf29ce484222325ULL, &buf->error, sizeof(buf->error));
+	int i;
+
+	if (buf->error) {
+		h = fnv(h, &buf->error_line, sizeof(buf->error_line));
+		h = fnv(h, &buf->error_column, sizeof(buf->error_column));
+		return fnv(h, buf->error_message, strlen(buf->error_message));
+	}
+
+	TOKENS_EACH(buf->stream, tok) {
+		int fields[5] = { tok.type, tok.offset, tok.length, tok.line, tok.symbol };
+		h = fnv(h, fields, sizeof(fields));
+		h = fnv(h, Token_value(&tok, buf->src), tok.length);
+	}
+
+	for (i = 0; i < buf->resync_count; i++)
+		h = fnv(h, &buf->resync[i], sizeof(ResyncPoint));
+
+	return h;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// A copy of src with [start, end) replaced by piece, padded like a Source.
+static char *edit_src(const char *src, long size, long start, long end, const char *piece, long *new_size) {
+	long length = strlen(piece);
+
+	*new_size = size - (end - start) + length;
+	char *edited = calloc(*new_size + SOURCE_PADDING, 1);
+	if (edited == NULL)
+		return NULL;
+
+	memcpy(edited, src, start);
+	memcpy(edited + start, piece, length);
+	memcpy(edited + start + length, src + end, size - end);
+	return edited;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static int bench(const char *name, const char *original, long size, int edits) {
+	SymbolTable *symbols = SymbolTable_create(0);
+	double relexed = 0, applied = 0, lexed = 0;
+	long tokens = 0, early = 0, errors = 0, mismatches = 0;
+	int i;
+
+	char *src = malloc(size + SOURCE_PADDING);
+	check_mem(symbols && src);
+	memcpy(src, original, size + SOURCE_PADDING);
+
+	Buffer *old = Buffer_create(src, size);
+	check_mem(old);
+	old->symbols = symbols;
+	old->track_resync = 1;
+	check(tokenize(old) >= 0, "%s doesn't lex: %s", name, old->error_message);
+
+	srand(11);
+
+	for (i = 0; i < edits; i++) {
+		long start = (long)rand() * rand() % (size + 1);
+		long end = start + rand() % 6;
+		const char *piece = rand() % 3 ? pieces[rand() % PIECE_COUNT] : "";
+		long new_size;
+
+		if (end > size)
+			end = size;
+
+		char *edited = edit_src(src, size, start, end, piece, &new_size);
+		check_mem(edited);
+
+		SourceEdit edit = { start, end, start + (long)strlen(piece) };
+		TokenSplice splice;
+
+		double t0 = now();
+		int count = relex(old, edited, new_size, edit, &splice);
+		double t1 = now();
+		Buffer *spliced = count >= 0 ? TokenSplice_apply(old, &splice) : NULL;
+		double t2 = now();
+
+		Buffer *full = Buffer_create(edited, new_size);
+		check_mem(full);
+		full->symbols = symbols;
+		full->track_resync = 1;
+		tokenize(full);
+		double t3 = now();
+
+		relexed += t1 - t0;
+		applied += t2 - t1;
+		lexed += t3 - t2;
+		tokens += splice.added;
+		early += splice.buf && splice.end < new_size;
+
+		uint64_t expected = buf_hash(full);
+		uint64_t actual = count >= 0 ? (spliced ? buf_hash(spliced) : 0) : (splice.buf ? buf_hash(splice.buf) : 0);
+
+		if (actual != expected) {
+			if (mismatches++ < 10)
+				log_err("%s: edit %d at [%ld, %ld) -> \"%s\" differs from tokenize", name, i, start, end, piece);
+		}
+
+		TokenSplice_release(&splice);
+		Buffer_destroy(full);
+
+		// Keep the new stream if the template still lexes, else undo.
+		if (spliced) {
+			Buffer_destroy(old);
+			free(src);
+			old = spliced;
+			src = edited;
+			size = new_size;
+		} else {
+			errors++;
+			free(edited);
+		}
+	}
+
+	printf("%s: %ld bytes, %d edits (%ld not lexing), %ld relexed up to a resync point, %s\n",
+			name, size, edits, errors, early, mismatches ? "MISMATCH" : "ok");
+	printf("  relex    %9.3f ms/edit  %9.0f tokens/edit\n", relexed * 1000 / edits, (double)tokens / edits);
+	printf("  apply    %9.3f ms/edit\n", applied * 1000 / edits);
+	printf("  tokenize %9.3f ms/edit  %6.1fx\n", lexed * 1000 / edits, relexed > 0 ? lexed / relexed : 0);
+
+	Buffer_destroy(old);
+	free(src);
+	SymbolTable_destroy(symbols);
+	return mismatches != 0;
+error:
+	free(src);
+	SymbolTable_destroy(symbols);
+	return 1;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+int main(int argc, char *argv[]) {
+	int edits = 100;
+	int i, failed = 0;
+	const char *path = NULL;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+			edits = atoi(argv[++i]);
+		else
+			path = argv[i];
+	}
+
+	if (path) {
+		Source *source = Source_open(path);
+		if (source == NULL) {
+			log_err("Can't load %s", path);
+			return 1;
+		}
+		failed = bench(path, source->data, source->size, edits);
+		Source_close(source);
+	} else {
+		long snippet_size = strlen(snippet), size = 0;
+		long copies = 4 * 1024 * 1024 / snippet_size;
+		char *src = calloc(copies * snippet_size + SOURCE_PADDING, 1);
+
+		for (i = 0; i < copies; i++, size += snippet_size)
+			memcpy(src + size, snippet, snippet_size);
+
+		failed = bench("generated", src, size, edits);
+		free(src);
+	}
+
+	return failed;
+}
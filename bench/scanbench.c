@@ -0,0 +1,195 @@
+// Text/comment/line scanner benchmark.
+//
+//     bench/scanbench
+//
+// Before timing anything, every vector scanner is checked against the
+// byte-at-a-time scanner on random buffers dense in delimiters, for every
+// start position and several end positions, so SIMD and scalar are known
+// to agree. Then each variant is timed on plain text lines and on one long
+// comment, and the line scanners on building a line index of the text.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "debug.h"
+#include "scan.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+typedef struct Variant {
+	const char *name;
+	Scanner text, comment;
+	LineScanner lines;
+	int supported;
+} Variant;
+
+static Variant variants[] = {
+	{ "scalar", scan_text_scalar, scan_comment_scalar, scan_lines_scalar, 1 },
+#ifdef MANANA_SCAN_X86
+	{ "sse2", scan_text_sse2, scan_comment_sse2, scan_lines_sse2, 1 },
+	{ "avx2", scan_text_avx2, scan_comment_avx2, scan_lines_avx2, 0 },
+#endif
+};
+
+#define VARIANT_COUNT (int)(sizeof(variants) / sizeof(variants[0]))
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static int check_variants(int rounds) {
+	static const char alphabet[] = "ab @{\"\n\"\"@{{@ x\"";
+	char src[300];
+	uint32_t starts[300], expected[300];
+	int round, pos, end, v, failures = 0;
+
+	srand(42);
+
+	for (round = 0; round < rounds; round++) {
+		int i;
+		for (i = 0; i < (int)sizeof(src); i++)
+			src[i] = alphabet[rand() % (sizeof(alphabet) - 1)];
+		// Now and then, NULs in the middle too.
+		if (round % 4 == 0)
+			src[rand() % sizeof(src)] = '\0';
+
+		for (pos = 0; pos < (int)sizeof(src); pos++) {
+			for (end = pos; end <= (int)sizeof(src); end += 1 + rand() % 7) {
+				size_t text = scan_text_scalar(src, pos, end);
+				size_t comment = scan_comment_scalar(src, pos, end);
+				size_t lines = scan_lines_scalar(src, pos, end, expected);
+
+				for (v = 1; v < VARIANT_COUNT; v++) {
+					if (!variants[v].supported)
+						continue;
+					if (variants[v].text(src, pos, end) != text ||
+							variants[v].comment(src, pos, end) != comment ||
+							variants[v].lines(src, pos, end, NULL) != lines ||
+							variants[v].lines(src, pos, end, starts) != lines ||
+							memcmp(starts, expected, lines * sizeof(uint32_t)) != 0) {
+						if (failures++ < 10)
+							log_err("%s differs from scalar at round %d, pos %d, end %d",
+									variants[v].name, round, pos, end);
+					}
+				}
+			}
+		}
+	}
+
+	return failures;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Scan src from start to end the way the lexer does: one run at a time,
+// stepping over each delimiter found.
+static void time_scanner(const char *label, const char *name, Scanner scan, const char *src, size_t size, int step) {
+	int iterations = 20;
+	long runs = 0;
+	int i;
+
+	double start = now();
+	for (i = 0; i < iterations; i++) {
+		size_t pos = 0;
+		while (pos < size) {
+			pos = scan(src, pos, size) + step;
+			runs++;
+		}
+	}
+	double elapsed = now() - start;
+
+	printf("%-8s %-8s %8.0f MB/s  %10ld runs\n", label, name,
+			(double)size * iterations / elapsed / (1024 * 1024), runs / iterations);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Count the lines of src, then record where each starts, the way
+// LineIndex_create does.
+static void time_lines(const char *name, LineScanner scan, const char *src, size_t size) {
+	int iterations = 20;
+	size_t lines = 0;
+	int i;
+
+	uint32_t *starts = malloc((scan(src, 0, size, NULL) + 1) * sizeof(uint32_t));
+	if (starts == NULL)
+		return;
+
+	double start = now();
+	for (i = 0; i < iterations; i++) {
+		lines = scan(src, 0, size, NULL);
+		scan(src, 0, size, starts);
+	}
+	double elapsed = now() - start;
+
+	printf("%-8s %-8s %8.0f MB/s  %10zu lines\n", "lines", name,
+			(double)size * iterations / elapsed / (1024 * 1024), lines);
+	free(starts);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+int main(void) {
+	size_t size = 64 * 1024 * 1024;
+	int v;
+
+#ifdef MANANA_SCAN_X86
+	__builtin_cpu_init();
+	variants[2].supported = __builtin_cpu_supports("avx2");
+#endif
+
+	int failures = check_variants(200);
+	printf("differential check: %s (%d mismatches), runtime choice: %s\n",
+			failures ? "FAILED" : "ok", failures, scan_variant());
+	if (failures)
+		return 1;
+
+	// Text: lines of 20-120 characters with the odd "@{" in between.
+	char *text = malloc(size + 1);
+	check_mem(text);
+
+	size_t i = 0;
+	srand(7);
+	while (i < size) {
+		size_t len = 20 + rand() % 100;
+		size_t j;
+		for (j = 0; j < len && i < size; j++, i++)
+			text[i] = 'a' + (i % 26);
+		if (i + 2 < size && rand() % 4 == 0) {
+			text[i++] = '@';
+			text[i++] = '{';
+		}
+		if (i < size)
+			text[i++] = '\n';
+	}
+	text[size] = '\0';
+
+	// Comment: one big comment body with no closing quotes until the end.
+	char *comment = malloc(size + 1);
+	check_mem(comment);
+	memset(comment, 'x', size);
+	for (i = 0; i < size; i += 61)
+		comment[i] = i % 3 ? '\n' : '"';
+	comment[size] = '\0';
+
+	for (v = 0; v < VARIANT_COUNT; v++) {
+		if (variants[v].supported)
+			time_scanner("text", variants[v].name, variants[v].text, text, size, 1);
+	}
+	for (v = 0; v < VARIANT_COUNT; v++) {
+		if (variants[v].supported)
+			time_scanner("comment", variants[v].name, variants[v].comment, comment, size, 3);
+	}
+	for (v = 0; v < VARIANT_COUNT; v++) {
+		if (variants[v].supported)
+			time_lines(variants[v].name, variants[v].lines, text, size);
+	}
+
+	free(text);
+	free(comment);
+	return 0;
+error:
+	return 1;
+}
@@ -0,0 +1,139 @@
+// Split lexing benchmark: lexes large templates with tokenize and with
+// tokenize_split at several chunk sizes and thread counts, and reports
+// throughput. That the split streams are the same as the sequential one is
+// checked by test/splittest.
+//
+//     make bench
+//     bench/splitbench [-t threads] [-n iterations] [file ...]
+//
+// Without files it repeats test/split.manana to a few MB in memory. Its
+// """ comments, :filter blocks and strings cross column-0 lines, so that
+// many of the guessed chunk boundaries are wrong. Runs alternate between
+// a concurrent SymbolTable, which the chunks intern into as they're lexed,
+// and a plain one, which names are interned into as the chunks are
+// stitched.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "lexer.h"
+#include "source.h"
+#include "split.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Lex src, threads > 1 splitting it into chunks.
+static int lex(char *src, long size, SymbolTable *symbols, int threads, long chunk_size) {
+	int count;
+
+	Buffer *buf = Buffer_create(src, size);
+	if (buf == NULL)
+		return -1;
+
+	buf->symbols = symbols;
+	count = threads > 1 ? tokenize_split(buf, threads, chunk_size) : tokenize(buf);
+
+	Buffer_destroy(buf);
+	return count;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static int bench(const char *name, char *src, long size, int threads, int iterations) {
+	static const long chunk_sizes[] = { 64, 4096, 256 * 1024, SPLIT_CHUNK_SIZE };
+	SymbolTable *tables[2] = { SymbolTable_create(0), SymbolTable_create(1) };
+	int i, j, n, count = 0;
+
+	if (tables[0] == NULL || tables[1] == NULL) {
+		SymbolTable_destroy(tables[0]);
+		SymbolTable_destroy(tables[1]);
+		return 1;
+	}
+
+	double start = now();
+	for (i = 0; i < iterations; i++)
+		count = lex(src, size, tables[0], 1, 0);
+	double base = now() - start;
+
+	printf("%s: %ld bytes, %d tokens\n", name, size, count);
+	printf("  sequential              %8.2f MB/s\n", (double)size * iterations / base / (1024 * 1024));
+
+	for (n = 2; ; n = n * 2 < threads ? n * 2 : threads) {
+		for (j = 0; j < (int)(sizeof(chunk_sizes) / sizeof(chunk_sizes[0])); j++) {
+			start = now();
+			for (i = 0; i < iterations; i++)
+				lex(src, size, tables[i % 2], n, chunk_sizes[j]);
+			double elapsed = now() - start;
+
+			printf("  %2d threads %8ld B   %8.2f MB/s  %5.2fx\n",
+					n, chunk_sizes[j], (double)size * iterations / elapsed / (1024 * 1024),
+					base / elapsed);
+		}
+		if (n >= threads)
+			break;
+	}
+
+	SymbolTable_destroy(tables[0]);
+	SymbolTable_destroy(tables[1]);
+	return 0;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+int main(int argc, char *argv[]) {
+	int threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int iterations = 5;
+	int i, files = 0, failed = 0;
+
+	if (threads < 2)
+		threads = 2;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+			threads = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			iterations = atoi(argv[++i]);
+		} else {
+			Source *source = Source_open(argv[i]);
+			if (source == NULL) {
+				log_err("Can't load %s", argv[i]);
+				failed = 1;
+				continue;
+			}
+			failed |= bench(argv[i], source->data, source->size, threads, iterations);
+			Source_close(source);
+			files++;
+		}
+	}
+
+	if (files == 0) {
+		Source *snippet = Source_open("test/split.manana");
+		if (snippet == NULL || snippet->size == 0) {
+			log_err("Can't load test/split.manana");
+			Source_close(snippet);
+			return 1;
+		}
+
+		long copies = 4 * 1024 * 1024 / snippet->size, size = 0;
+		char *src = calloc(copies * snippet->size + SOURCE_PADDING, 1);
+
+		for (i = 0; i < copies; i++, size += snippet->size)
+			memcpy(src + size, snippet->data, snippet->size);
+
+		failed |= bench("generated", src, size, threads, iterations);
+
+		// Starting indented changes where lex_eof dedents to.
+		src[0] = ' ';
+		failed |= bench("generated, indented", src, size, threads, iterations);
+		free(src);
+		Source_close(snippet);
+	}
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,151 @@
+// Thread benchmark: lexes the same corpus on 1..N threads at once and
+// reports the combined throughput. All threads intern into one concurrent
+// SymbolTable, so contention on it shows up here. That the streams are
+// the same as on one thread is checked by test/threadtest.
+//
+//     make bench
+//     bench/threadbench [-t threads] [-n iterations] [path ...]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "lexer.h"
+#include "source.h"
+#include "debug.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+typedef struct Corpus {
+	Source **sources;
+	int count;
+	long bytes;
+} Corpus;
+
+typedef struct Worker {
+	pthread_t thread;
+	Corpus *corpus;
+	int iterations;
+} Worker;
+
+static SymbolTable *symbols;
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static void lex(Source *source) {
+	Buffer *buf = Buffer_create(source->data, source->size);
+	if (buf == NULL)
+		return;
+
+	buf->symbols = symbols;
+	tokenize(buf);
+	Buffer_destroy(buf);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static void *worker_run(void *arg) {
+	Worker *worker = arg;
+	Corpus *corpus = worker->corpus;
+	int i, j;
+
+	for (i = 0; i < worker->iterations; i++) {
+		for (j = 0; j < corpus->count; j++)
+			lex(corpus->sources[j]);
+	}
+
+	return NULL;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static void run(Corpus *corpus, int threads, int iterations) {
+	Worker *workers = calloc(threads, sizeof(Worker));
+	int i;
+
+	double start = now();
+
+	for (i = 0; i < threads; i++) {
+		workers[i].corpus = corpus;
+		workers[i].iterations = iterations;
+		pthread_create(&workers[i].thread, NULL, worker_run, &workers[i]);
+	}
+
+	for (i = 0; i < threads; i++)
+		pthread_join(workers[i].thread, NULL);
+
+	double elapsed = now() - start;
+
+	printf("%3d threads  %8ld files  %8.2f MB/s\n",
+			threads, (long)corpus->count * iterations * threads,
+			(double)corpus->bytes * iterations * threads / elapsed / (1024 * 1024));
+
+	free(workers);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+int main(int argc, char *argv[]) {
+	int threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int iterations = 2000;
+	int i;
+	Array *paths = Array_create(0, 64);
+	Corpus corpus = { NULL, 0, 0 };
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+			threads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+			iterations = atoi(argv[++i]);
+		else
+			Source_find(argv[i], ".manana", paths);
+	}
+
+	if (Array_count(paths) == 0) {
+		Source_find("examples", ".manana", paths);
+		Source_find("bench", ".manana", paths);
+	}
+
+	if (threads < 1)
+		threads = 1;
+
+	symbols = SymbolTable_create(1);
+	check_mem(symbols);
+
+	corpus.sources = calloc(Array_count(paths), sizeof(Source *));
+	check_mem(corpus.sources);
+
+	for (i = 0; i < Array_count(paths); i++) {
+		Source *source = Source_open(Array_get(paths, i));
+		if (source == NULL) {
+			log_err("Can't load %s", (char *)Array_get(paths, i));
+			continue;
+		}
+
+		corpus.sources[corpus.count] = source;
+		corpus.bytes += source->size;
+		corpus.count++;
+	}
+
+	printf("%d files, %ld bytes\n", corpus.count, corpus.bytes);
+
+	for (i = 1; i < threads; i *= 2)
+		run(&corpus, i, iterations);
+	run(&corpus, threads, iterations);
+
+	for (i = 0; i < corpus.count; i++)
+		Source_close(corpus.sources[i]);
+	for (i = 0; i < Array_count(paths); i++)
+		free(Array_get(paths, i));
+	Array_destroy(paths);
+	free(corpus.sources);
+	SymbolTable_destroy(symbols);
+
+	return 0;
+error:
+	return 1;
+}
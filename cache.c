@@ -0,0 +1,442 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "debug.h"
+#include "cache.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// XXH64 with a seed of 0: four lanes of multiply-rotate over 32 bytes at
+// a time, a few GB/s, so checking a source against its cache costs far
+// less than lexing it.
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const uint8_t *p) {
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint32_t read32(const uint8_t *p) {
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint64_t hash_round(uint64_t acc, uint64_t input) {
+	return rotl64(acc + input * PRIME64_2, 31) * PRIME64_1;
+}
+
+static inline uint64_t hash_merge(uint64_t h, uint64_t acc) {
+	return (h ^ hash_round(0, acc)) * PRIME64_1 + PRIME64_4;
+}
+
+uint64_t TokenCache_hash(const void *data, size_t size) {
+	const uint8_t *p = data, *end = p + size;
+	uint64_t h;
+
+	if (size >= 32) {
+		uint64_t v1 = PRIME64_1 + PRIME64_2, v2 = PRIME64_2, v3 = 0, v4 = -PRIME64_1;
+
+		for (; p + 32 <= end; p += 32) {
+			v1 = hash_round(v1, read64(p));
+			v2 = hash_round(v2, read64(p + 8));
+			v3 = hash_round(v3, read64(p + 16));
+			v4 = hash_round(v4, read64(p + 24));
+		}
+
+		h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+		h = hash_merge(h, v1);
+		h = hash_merge(h, v2);
+		h = hash_merge(h, v3);
+		h = hash_merge(h, v4);
+	} else {
+		h = PRIME64_5;
+	}
+
+	h += size;
+
+	for (; p + 8 <= end; p += 8)
+		h = rotl64(h ^ hash_round(0, read64(p)), 27) * PRIME64_1 + PRIME64_4;
+	if (p + 4 <= end) {
+		h = rotl64(h ^ (read32(p) * PRIME64_1), 23) * PRIME64_2 + PRIME64_3;
+		p += 4;
+	}
+	for (; p < end; p++)
+		h = rotl64(h ^ (*p * PRIME64_5), 11) * PRIME64_1;
+
+	h ^= h >> 33;
+	h *= PRIME64_2;
+	h ^= h >> 29;
+	h *= PRIME64_3;
+	h ^= h >> 32;
+	return h;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Where src_path's cache goes. Returns -1 if path is too small for it.
+int TokenCache_path(const char *src_path, char *path, size_t size) {
+	int n = snprintf(path, size, "%s%s", src_path, TOKEN_CACHE_SUFFIX);
+
+	return n >= 0 && (size_t)n < size ? 0 : -1;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Write buf's token stream to path. The file is written next to path
+// and renamed over it, so a worker loading it never sees half a cache.
+// The values' strings are interned in a table of their own, to write
+// each distinct one once; the table's builtin names are written only if
+// a value uses them.
+//
+// A cache is only an optimization, so failing to write one (a read-only
+// tree, say) prints nothing: it returns -1 and the caller decides whether
+// that's worth mentioning. MANANA_TRACE=debug shows why.
+int TokenCache_save(Buffer *buf, const char *path) {
+	TokenStream *stream = buf->stream;
+	SymbolTable *strings = NULL;
+	TokenCacheValue *values = NULL;
+	TokenChunk *chunk = NULL;
+	uint32_t *string_at = NULL;
+	FILE *out = NULL;
+	char tmp[PATH_MAX];
+	int i, fd = -1, created = 0;
+
+	check_debug(buf->error == 0, "Can't cache %s: the template didn't lex.", path);
+	check_debug(snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path) < (int)sizeof(tmp), "Cache path too long: %s", path);
+
+	strings = SymbolTable_create(0);
+	values = malloc((stream->value_count + 1) * sizeof(TokenCacheValue));
+	chunk = malloc(sizeof(TokenChunk));
+	check_debug(strings && values && chunk, "Out of memory.");
+
+	// Symbols for now; they're turned into offsets once every string is in.
+	for (i = 0; i < stream->value_count; i++) {
+		TokenValue *value = &stream->values[i];
+
+		values[i].index = value->index;
+		values[i].lazy = value->lazy;
+		values[i].string = 0;
+
+		if (!value->lazy) {
+			values[i].string = SymbolTable_intern(strings, value->value, TokenStream_length(stream, value->index));
+			check_debug(values[i].string != SYM_NONE, "Out of memory.");
+		}
+	}
+
+	// Only the strings some value uses get an offset, UINT32_MAX the rest.
+	int string_count = SymbolTable_count(strings);
+	string_at = malloc((string_count + 1) * sizeof(uint32_t));
+	check_debug(string_at, "Out of memory.");
+	memset(string_at, 0xff, (string_count + 1) * sizeof(uint32_t));
+
+	for (i = 0; i < stream->value_count; i++) {
+		if (!values[i].lazy)
+			string_at[values[i].string] = 0;
+	}
+
+	uint32_t strings_size = 0;
+	for (i = 1; i <= string_count; i++) {
+		int length;
+
+		if (string_at[i] == UINT32_MAX)
+			continue;
+		SymbolTable_name(strings, i, &length);
+		string_at[i] = strings_size;
+		strings_size += length + 1;
+	}
+
+	for (i = 0; i < stream->value_count; i++) {
+		if (!values[i].lazy)
+			values[i].string = string_at[values[i].string];
+	}
+
+	TokenCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TOKEN_CACHE_MAGIC, sizeof(header.magic));
+	header.version = TOKEN_CACHE_VERSION;
+	header.chunk_size = TOKEN_CHUNK_SIZE;
+	header.type_count = TOKEN_TYPE_COUNT;
+	header.backend = buf->backend;
+	header.max_indent = buf->indent_stack.limit;
+	header.src_size = buf->src_size;
+	header.src_hash = TokenCache_hash(buf->src, buf->src_size);
+	header.count = stream->count;
+	header.chunk_count = stream->chunk_count;
+	header.value_count = stream->value_count;
+	header.strings_size = strings_size;
+
+	fd = mkstemp(tmp);
+	check_debug(fd >= 0, "Can't create %s", tmp);
+	created = 1;
+	fchmod(fd, 0644);
+
+	out = fdopen(fd, "wb");
+	check_debug(out, "Can't write %s", tmp);
+	fd = -1;
+
+	fwrite(&header, sizeof(header), 1, out);
+
+	// Symbols are the process's own, and the unused end of the last chunk
+	// is whatever the arena had there: both are written as zeros.
+	for (i = 0; i < stream->chunk_count; i++) {
+		int used = stream->count - i * TOKEN_CHUNK_SIZE;
+
+		memcpy(chunk, stream->chunks[i], sizeof(TokenChunk));
+		memset(chunk->symbol, 0, sizeof(chunk->symbol));
+		if (used < TOKEN_CHUNK_SIZE) {
+			memset(chunk->type + used, 0, TOKEN_CHUNK_SIZE - used);
+			memset(chunk->offset + used, 0, (TOKEN_CHUNK_SIZE - used) * sizeof(uint32_t));
+			memset(chunk->length + used, 0, (TOKEN_CHUNK_SIZE - used) * sizeof(uint32_t));
+		}
+		fwrite(chunk, sizeof(TokenChunk), 1, out);
+	}
+
+	fwrite(values, sizeof(TokenCacheValue), stream->value_count, out);
+
+	for (i = 1; i <= string_count; i++) {
+		int length;
+
+		if (string_at[i] == UINT32_MAX)
+			continue;
+		const char *name = SymbolTable_name(strings, i, &length);
+		fwrite(name, 1, length + 1, out);
+	}
+
+	check_debug(ferror(out) == 0, "Can't write %s", tmp);
+	i = fclose(out);
+	out = NULL;
+	check_debug(i == 0, "Can't write %s", tmp);
+	check_debug(rename(tmp, path) == 0, "Can't rename %s to %s", tmp, path);
+
+	SymbolTable_destroy(strings);
+	free(values);
+	free(chunk);
+	free(string_at);
+	return 0;
+error:
+	if (out)
+		fclose(out);
+	if (fd >= 0)
+		close(fd);
+	if (created)
+		unlink(tmp);
+	if (strings)
+		SymbolTable_destroy(strings);
+	free(values);
+	free(chunk);
+	free(string_at);
+	return -1;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Whether a cache of size bytes is laid out the way this build writes
+// them and was made from buf's source by a lexer set up like buf's. The
+// hash is last, being the only check that reads the source.
+static int TokenCache_matches(const TokenCacheHeader *header, size_t size, Buffer *buf) {
+	uint64_t expected = sizeof(TokenCacheHeader)
+		+ (uint64_t)header->chunk_count * sizeof(TokenChunk)
+		+ (uint64_t)header->value_count * sizeof(TokenCacheValue)
+		+ header->strings_size;
+
+	return memcmp(header->magic, TOKEN_CACHE_MAGIC, sizeof(header->magic)) == 0
+		&& header->version == TOKEN_CACHE_VERSION
+		&& header->chunk_size == TOKEN_CHUNK_SIZE
+		&& header->type_count == TOKEN_TYPE_COUNT
+		&& header->backend == (uint32_t)buf->backend
+		&& header->max_indent == (uint32_t)buf->indent_stack.limit
+		&& header->count <= INT_MAX
+		&& header->chunk_count == ((uint64_t)header->count + TOKEN_CHUNK_MASK) >> TOKEN_CHUNK_BITS
+		&& expected == size
+		&& (header->strings_size == 0 || ((const char *)header)[size - 1] == '\0')
+		&& header->src_size == (uint64_t)buf->src_size
+		&& header->src_hash == TokenCache_hash(buf->src, buf->src_size);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Whether every token can be read without going out of bounds: a known
+// type, a slice inside the source, and a value inside the strings, with
+// the values in token order. A hash that matches says the cache is for
+// this source, not that the file wasn't damaged since.
+//
+// The chunks are checked without looking at the values, so the loop
+// vectorizes: only tokens with an implied or materialized value may end
+// past the source, and there must be no more that do than there are such
+// values.
+static int TokenCache_readable(TokenStream *stream, const TokenCacheValue *cached, const char *strings, uint32_t strings_size) {
+	uint64_t src_size = stream->src_size;
+	long outside = 0;
+	uint8_t type = 0;
+	int i, j;
+
+	for (i = 0; i < stream->chunk_count; i++) {
+		TokenChunk *chunk = stream->chunks[i];
+		int used = stream->count - i * TOKEN_CHUNK_SIZE;
+
+		if (used > TOKEN_CHUNK_SIZE)
+			used = TOKEN_CHUNK_SIZE;
+
+		for (j = 0; j < used; j++) {
+			type = chunk->type[j] > type ? chunk->type[j] : type;
+			outside += (uint64_t)chunk->offset[j] + chunk->length[j] > src_size;
+		}
+	}
+
+	if (stream->count > 0 && type >= TOKEN_TYPE_COUNT)
+		return 0;
+
+	for (i = 0; i < stream->value_count; i++) {
+		uint32_t index = cached[i].index;
+
+		if (index >= (uint32_t)stream->count || (i > 0 && index <= cached[i - 1].index))
+			return 0;
+
+		int offset = TokenStream_offset(stream, index);
+		uint32_t length = TokenStream_length(stream, index);
+
+		if (cached[i].lazy > LAZY_DATA_KEY)
+			return 0;
+
+		if (!cached[i].lazy) {
+			if ((uint64_t)cached[i].string + length >= strings_size || strings[cached[i].string + length] != '\0')
+				return 0;
+			outside -= (uint64_t)(uint32_t)offset + length > src_size;
+		}
+	}
+
+	return outside == 0;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Intern the names of a stream that was loaded without symbols. The
+// mapping is private, so this only copies the pages it writes to.
+static int TokenCache_intern(Buffer *buf) {
+	TokenStream *stream = buf->stream;
+	TokenIter it = TokenStream_iter_raw(stream);
+	Token tok;
+
+	while (TokenIter_next(&it, &tok)) {
+		if (!Token_has_symbol(tok.type))
+			continue;
+
+		Symbol symbol = Buffer_intern(buf, &tok);
+		if (symbol == SYM_NONE)
+			return -1;
+
+		int i = it.index - 1;
+		TokenStream_chunk(stream, i)->symbol[i & TOKEN_CHUNK_MASK] = symbol;
+	}
+
+	return 0;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Load buf's tokens from the cache at path instead of lexing. buf must
+// not have lexed anything yet. Returns the number of tokens, or -1 if
+// there's no cache for buf's source there, in which case buf is as it
+// was and can be lexed as usual.
+int TokenCache_load(Buffer *buf, const char *path) {
+	TokenStream *stream = buf->stream;
+	char *map = MAP_FAILED;
+	size_t size = 0;
+	struct stat st;
+	int i;
+
+	if (buf->error || buf->pos != 0 || TokenStream_count(stream) > 0)
+		return -1;
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(TokenCacheHeader)) {
+		size = st.st_size;
+		map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	}
+	close(fd);
+
+	if (map == MAP_FAILED)
+		return -1;
+
+	const TokenCacheHeader *header = (const TokenCacheHeader *)map;
+	if (!TokenCache_matches(header, size, buf))
+		goto miss;
+
+	char *chunks = map + sizeof(TokenCacheHeader);
+	const TokenCacheValue *cached = (const TokenCacheValue *)(chunks + (size_t)header->chunk_count * sizeof(TokenChunk));
+	const char *strings = (const char *)(cached + header->value_count);
+
+	TokenChunk **chunk_index = Arena_alloc(buf->arena, (header->chunk_count + 1) * sizeof(TokenChunk *));
+	TokenValue *values = Arena_alloc(buf->arena, (header->value_count + 1) * sizeof(TokenValue));
+	if (chunk_index == NULL || values == NULL)
+		goto miss;
+	mem_arena(buf->arena, MEM_TOKENS, (header->chunk_count + 1) * sizeof(TokenChunk *));
+	mem_arena(buf->arena, MEM_TOKENS, (header->value_count + 1) * sizeof(TokenValue));
+
+	for (i = 0; i < (int)header->chunk_count; i++)
+		chunk_index[i] = (TokenChunk *)(chunks + (size_t)i * sizeof(TokenChunk));
+
+	stream->chunks = chunk_index;
+	stream->chunk_count = stream->chunk_max = header->chunk_count;
+	stream->count = header->count;
+	stream->values = values;
+	stream->value_count = stream->value_max = header->value_count;
+
+	if (!TokenCache_readable(stream, cached, strings, header->strings_size))
+		goto reset;
+
+	for (i = 0; i < stream->value_count; i++) {
+		values[i].index = cached[i].index;
+		values[i].lazy = cached[i].lazy;
+		values[i].value = cached[i].lazy ? NULL : strings + cached[i].string;
+	}
+
+	if (buf->symbols && TokenCache_intern(buf) != 0)
+		goto reset;
+
+	stream->map = map;
+	stream->map_size = size;
+	buf->pos = buf->limit;
+	return stream->count;
+
+reset:
+	stream->chunks = NULL;
+	stream->values = NULL;
+	stream->count = stream->chunk_count = stream->chunk_max = 0;
+	stream->value_count = stream->value_max = 0;
+miss:
+	munmap(map, size);
+	return -1;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// tokenize, through the cache next to src_path: load it if it's for buf's
+// source, otherwise lex and save a new one. Not being able to save it
+// isn't an error; the template is just lexed again next time.
+int tokenize_cached(Buffer *buf, const char *src_path) {
+	char path[PATH_MAX];
+	int count;
+
+	if (TokenCache_path(src_path, path, sizeof(path)) != 0)
+		return tokenize(buf);
+
+	if ((count = TokenCache_load(buf, path)) >= 0)
+		return count;
+
+	count = tokenize(buf);
+	if (count >= 0)
+		TokenCache_save(buf, path);
+
+	return count;
+}
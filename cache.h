@@ -0,0 +1,56 @@
+#ifndef _MANANA_CACHE_H
+#define _MANANA_CACHE_H
+
+#include <stdint.h>
+#include "lexer.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// A template's token stream saved next to it (page.manana.tokens), so a
+// worker that starts on an unchanged template maps it back in instead of
+// lexing it again.
+//
+// The file is the stream's own chunks, written as they are in memory, so
+// loading maps the file copy-on-write and points the stream's chunks into
+// the mapping: nothing is parsed or copied. After the chunks come the
+// implied and lazy values by token index, then the values' strings, each
+// distinct one once and NUL-terminated. Lazy values stay lazy; they are
+// slices of the source like every other token.
+//
+// A cache is only used for the source it was made from, by a lexer set up
+// the same way: the header holds the source's size and a 64-bit hash of
+// its bytes, the backend that lexed it and the Buffer's indent limit, and
+// a cache whose hash, size, backend, limit, version or layout doesn't
+// match is ignored. Symbols belong to a process's SymbolTable, so they're
+// saved as 0 and interned again on load if the Buffer has a table. Bump
+// TOKEN_CACHE_VERSION whenever the file's format or the lexer's output for
+// the same source changes. Caches are in the byte order of the machine
+// that wrote them; elsewhere they just don't match.
+//
+// Version 2 added backend and max_indent.
+#define TOKEN_CACHE_MAGIC "MTKC"
+#define TOKEN_CACHE_VERSION 2
+#define TOKEN_CACHE_SUFFIX ".tokens"
+
+typedef struct TokenCacheHeader {
+	char magic[4];
+	uint32_t version, chunk_size, type_count;
+	uint32_t backend, max_indent;
+	uint64_t src_size, src_hash;
+	uint32_t count, chunk_count, value_count, strings_size;
+} TokenCacheHeader;
+
+// index is the token's; string is where its value starts in the strings,
+// unused if the value is lazy.
+typedef struct TokenCacheValue {
+	uint32_t index, lazy, string;
+} TokenCacheValue;
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+uint64_t TokenCache_hash(const void *data, size_t size);
+int TokenCache_path(const char *src_path, char *path, size_t size);
+int TokenCache_save(Buffer *buf, const char *path);
+int TokenCache_load(Buffer *buf, const char *path);
+int tokenize_cached(Buffer *buf, const char *src_path);
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+#endif
@@ -0,0 +1,52 @@
+#ifndef _MANANA_CHARCLASS_H
+#define _MANANA_CHARCLASS_H
+
+#include <stdint.h>
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Character classes used by the lexer, one bit each. A character can be in
+// several classes; char_class[c] holds all of them. The table is fixed at
+// compile time and only knows ASCII, so unlike <ctype.h> it doesn't depend
+// on the locale.
+enum {
+	CC_ALPHA       = 1 << 0, // A-Z a-z
+	CC_DIGIT       = 1 << 1, // 0-9
+	CC_ALNUM       = 1 << 2, // tag names
+	CC_IDENT_START = 1 << 3, // first character of a name
+	CC_IDENT       = 1 << 4, // rest of a name, filter names
+	CC_CSS_NAME    = 1 << 5, // tag IDs, classes and attribute keys
+	CC_NUMBER      = 1 << 6, // digits and "."
+	CC_SPACE       = 1 << 7, // indentation and separating whitespace
+	CC_DELIM       = 1 << 8  // newline and NUL end a line
+};
+
+#define CC_LETTER (CC_ALPHA | CC_ALNUM | CC_IDENT_START | CC_IDENT | CC_CSS_NAME)
+#define CC_NUMERAL (CC_DIGIT | CC_ALNUM | CC_IDENT | CC_CSS_NAME | CC_NUMBER)
+
+static const uint16_t char_class[256] = {
+	['\0'] = CC_DELIM,
+	['\n'] = CC_DELIM,
+	[' '] = CC_SPACE,
+	['\t'] = CC_SPACE,
+	['-'] = CC_CSS_NAME,
+	['_'] = CC_IDENT_START | CC_IDENT | CC_CSS_NAME,
+	['.'] = CC_NUMBER,
+	['0' ... '9'] = CC_NUMERAL,
+	['A' ... 'Z'] = CC_LETTER,
+	['a' ... 'z'] = CC_LETTER
+};
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+#define is_class(C, MASK) (char_class[(unsigned char)(C)] & (MASK))
+
+// Length of the run of characters in MASK starting at p. NUL is only in
+// CC_DELIM, so a run can't go past the end of a NUL-terminated source.
+static inline int span_class(const char *p, unsigned mask) {
+	const char *s = p;
+	while (char_class[(unsigned char)*p] & mask)
+		p++;
+	return p - s;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+#endif
@@ -4,11 +4,20 @@
 #include <stdio.h>
 #include <errno.h>
 #include <string.h>
+#include "trace.h"
 
-#ifdef NDEBUG
+// debug() messages are part of tracing: compiled in with MANANA_TRACE and
+// printed only when the "debug" subsystem is enabled.
+#if defined(NDEBUG) || !defined(MANANA_TRACE)
 #define debug(M, ...)
 #else
-#define debug(M, ...) fprintf(stderr, "DEBUG %s:%d: " M "\n", __FILE__, __LINE__, ##__VA_ARGS__)
+#define debug(M, ...)\
+	do {\
+		if (trace_enabled(TRACE_DEBUG)) {\
+			fprintf(stderr, "DEBUG %s:%d: " M "\n", __FILE__, __LINE__, ##__VA_ARGS__);\
+			trace(TRACE_DEBUG, DEBUG_MSG, __LINE__, 0, 0);\
+		}\
+	} while (0)
 #endif
 
 #define clean_errno() (errno == 0 ? "None" : strerror(errno))
@@ -0,0 +1,416 @@
+#include "dfa.h"
+#include "dfa_tables.h"
+#include "scan.h"
+
+static void dfa_tag(Buffer *buf, int is_anchor);
+static void dfa_attrs(Buffer *buf);
+static void dfa_inline_vars(Buffer *buf);
+static void dfa_text(Buffer *buf, TokenType type);
+static void dfa_str(Buffer *buf);
+static void dfa_name(Buffer *buf);
+static void dfa_path(Buffer *buf);
+static void dfa_directive(Buffer *buf, TokenType type);
+static void dfa_cond(Buffer *buf);
+static void dfa_binding(Buffer *buf);
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// The longest match in mode from buf->pos: moves past it and returns its
+// rule, with start where it began. Without one nothing moves and it's NULL.
+// The DFA stops at the first byte that can't go on any match, NUL at the
+// latest (tools/gendfa makes sure of that).
+static inline const DfaRule *dfa_match(Buffer *buf, DfaMode mode) {
+	const unsigned char *p = (const unsigned char *)buf->src + buf->pos;
+	int state = dfa_start[mode], rule = 0, length = 0, i;
+
+	for (i = 0; (state = dfa_next[state][dfa_class[p[i]]]) != 0; i++) {
+		if (dfa_accept[state]) {
+			rule = dfa_accept[state];
+			length = i + 1;
+		}
+	}
+
+	Buffer_set_start(buf);
+	if (rule == 0)
+		return NULL;
+
+	Buffer_jump(buf, length);
+	return &dfa_rules[rule - 1];
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Emit the match as the rule's token, less skip characters at the start.
+static inline void dfa_emit(Buffer *buf, const DfaRule *rule) {
+	Buffer_set_slice(buf, buf->start + rule->skip);
+	emit(buf, rule->token);
+}
+
+#define is_line_end(C) ((C) == '\n' || (C) == '\0')
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+void dfa_initial(Buffer *buf) {
+	trace_state(buf, LEX_INITIAL);
+
+	Buffer_set_start(buf);
+
+	// The next line of a filter block.
+	if (buf->filter_indent >= 0) {
+		if (lex_filter_indent(buf))
+			dfa_text(buf, TEXT);
+		return;
+	}
+
+	const DfaRule *rule = dfa_match(buf, MODE_LINE);
+	if (rule == NULL)
+		Buffer_error(buf, "Illegal character \"%c\".", buf->ch);
+
+	switch (rule->action) {
+	case ACTION_INDENT:
+		Buffer_unread(buf);
+		lex_indent(buf);
+		break;
+	case ACTION_NEWLINE:
+		lex_indent(buf);
+		break;
+	case ACTION_EOF:
+		Buffer_unread(buf);
+		lex_eof(buf);
+		// Set buf->pos out of bounds to break tokenize function.
+		buf->pos++;
+		break;
+	case ACTION_ANCHOR:
+	case ACTION_TAG:
+		dfa_emit(buf, rule);
+		dfa_tag(buf, rule->action == ACTION_ANCHOR);
+		break;
+	case ACTION_DIV:
+		Buffer_unread(buf);
+		Buffer_set_value(buf, "div", 3);
+		emit(buf, TAG);
+		dfa_tag(buf, 0);
+		break;
+	case ACTION_DIRECTIVE:
+		dfa_emit(buf, rule);
+		dfa_directive(buf, rule->token);
+		break;
+	case ACTION_FILTER:
+		dfa_emit(buf, rule);
+		if (lex_filter_open(buf))
+			dfa_text(buf, TEXT);
+		break;
+	case ACTION_NAME:
+		Buffer_unread(buf);
+		dfa_name(buf);
+		break;
+	case ACTION_COMMENT:
+		Buffer_unread(buf);
+		lex_comment(buf);
+		break;
+	default:
+		Buffer_error(buf, "No action for rule %d in this mode.", (int)(rule - dfa_rules));
+	}
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// The rest of a tag's line: IDs, classes, attributes, inline variables,
+// src/href and, from anything else on, text.
+static void dfa_tag(Buffer *buf, int is_anchor) {
+	trace_state(buf, LEX_TAG);
+
+	Buffer_read_ignore_whitespace(buf);
+
+	while (!is_line_end(buf->ch)) {
+		Buffer_read_ignore_whitespace(buf);
+		if (is_line_end(buf->ch))
+			break;
+
+		const DfaRule *rule = dfa_match(buf, MODE_TAG);
+		if (rule == NULL) {
+			dfa_text(buf, TAGTEXT);
+			continue;
+		}
+
+		switch (rule->action) {
+		case ACTION_EMIT:
+			dfa_emit(buf, rule);
+			break;
+		case ACTION_ATTRS:
+			dfa_attrs(buf);
+			break;
+		case ACTION_INLINE:
+			Buffer_unread(buf);
+			dfa_inline_vars(buf);
+			break;
+		case ACTION_SRC:
+			Buffer_read_ignore_whitespace(buf);
+
+			if (is_anchor)
+				Buffer_set_value(buf, "href", 4);
+			else
+				Buffer_set_value(buf, "src", 3);
+			emit(buf, ATTRKEY);
+
+			Buffer_set_value(buf, "=", 1);
+			emit(buf, ATTREQ);
+
+			if (buf->ch == '"' || buf->ch == '\'')
+				dfa_str(buf);
+			break;
+		default:
+			Buffer_error(buf, "No action for rule %d in this mode.", (int)(rule - dfa_rules));
+		}
+	}
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// After the "(".
+static void dfa_attrs(Buffer *buf) {
+	trace_state(buf, LEX_TAG_ATTRS);
+
+	while (buf->ch != ')' && buf->ch != '\0') {
+		Buffer_read_ignore_whitespace(buf);
+
+		const DfaRule *rule = dfa_match(buf, MODE_ATTRS);
+		if (rule == NULL) {
+			if (buf->ch == '\0')
+				Buffer_error(buf, "Unclosed tag attributes!");
+			else if (buf->ch != ')')
+				Buffer_error(buf, "Invalid character \"%c\" in tag attributes.", buf->ch);
+			continue;
+		}
+
+		switch (rule->action) {
+		case ACTION_EMIT:
+			dfa_emit(buf, rule);
+			break;
+		case ACTION_DATA:
+			// The "data-" prefix isn't in the source; it's added when the
+			// value is materialized.
+			Buffer_set_slice(buf, buf->start + rule->skip);
+			Buffer_set_lazy(buf, buf->offset, LAZY_DATA_KEY, buf->length + 5);
+			emit(buf, rule->token);
+			break;
+		case ACTION_STRING:
+			Buffer_unread(buf);
+			dfa_str(buf);
+			break;
+		default:
+			Buffer_error(buf, "No action for rule %d in this mode.", (int)(rule - dfa_rules));
+		}
+	}
+
+	Buffer_jump(buf, 1); // Advance buffer past closing ")"
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// At the "=": a name, and nothing else up to the end of the line.
+static void dfa_inline_vars(Buffer *buf) {
+	trace_state(buf, LEX_TAG_INLINE_VARS);
+
+	Buffer_jump(buf, 1);
+	Buffer_read_ignore_whitespace(buf);
+
+	if (is_class(buf->ch, CC_ALPHA)) {
+		dfa_path(buf);
+		Buffer_read_ignore_whitespace(buf);
+	}
+
+	if (!is_line_end(buf->ch)) {
+		int from = buf->pos;
+
+		while (!is_line_end(buf->ch))
+			Buffer_read(buf);
+		Buffer_set_slice(buf, from);
+
+		emit(buf, ILLEGAL);
+		Buffer_error(buf, "Invalid inline variable.");
+	}
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Text up to the end of the line, with names in it. The runs between
+// names are found by scan_text rather than the DFA.
+static void dfa_text(Buffer *buf, TokenType type) {
+	trace_state(buf, type == TAGTEXT ? LEX_TAG_TEXT : LEX_TEXT);
+
+	Buffer_set_start(buf);
+	Buffer_read_ignore_whitespace(buf);
+
+	while (!is_line_end(buf->ch)) {
+		int from = buf->pos;
+
+		Buffer_jump(buf, scan_text(buf->src, buf->pos, buf->src_size + 1) - buf->pos);
+		Buffer_set_slice(buf, from);
+		emit(buf, type);
+
+		if (buf->ch == '@' && buf->next == '{')
+			dfa_name(buf);
+	}
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// At the opening quote.
+static void dfa_str(Buffer *buf) {
+	trace_state(buf, LEX_STR);
+
+	char quote = buf->ch;
+	DfaMode mode = quote == '"' ? MODE_DQUOTE : MODE_SQUOTE;
+
+	Buffer_jump(buf, 1); // Advance past opening quote.
+
+	int from = buf->pos;
+	int escapes = 0;
+	int is_interpolated = 0;
+
+	for (;;) {
+		const DfaRule *rule = dfa_match(buf, mode);
+		if (rule == NULL)
+			Buffer_error(buf, "Unclosed string!");
+
+		switch (rule->action) {
+		case ACTION_CHARS:
+			break;
+		case ACTION_ESCAPE:
+			escapes++;
+			break;
+		case ACTION_NAME:
+			is_interpolated = 1;
+
+			Buffer_unread(buf);
+			Buffer_set_str(buf, from, quote, escapes);
+			emit(buf, ISTR);
+			escapes = 0;
+
+			dfa_name(buf);
+			from = buf->pos;
+			break;
+		case ACTION_CLOSE:
+			Buffer_unread(buf);
+			Buffer_set_str(buf, from, quote, escapes);
+			emit(buf, is_interpolated ? ISTR : STR);
+
+			Buffer_jump(buf, 1); // Advance past closing quote.
+			return;
+		default:
+			Buffer_error(buf, "No action for rule %d in this mode.", (int)(rule - dfa_rules));
+		}
+	}
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// At the "@{" of a name.
+static void dfa_name(Buffer *buf) {
+	trace_state(buf, LEX_NAME);
+
+	Buffer_jump(buf, 2); // Ignore "@{" delimiter.
+	Buffer_read_ignore_whitespace(buf);
+
+	while (buf->ch != '}' && buf->ch != '\0') {
+		Buffer_read_ignore_whitespace(buf);
+
+		const DfaRule *rule = dfa_match(buf, MODE_NAME);
+		if (rule != NULL)
+			dfa_emit(buf, rule);
+		else if (buf->ch == '\n')
+			Buffer_error(buf, "Invalid name! Newline found inside name declaration.");
+		else if (buf->ch != '}' && buf->ch != '\0')
+			Buffer_error(buf, "Invalid character \"%c\" in name.", buf->ch);
+	}
+
+	Buffer_jump(buf, 1); // Move buffer after closing "}" delimiter.
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// A name without "@{}" around it: it ends at the first character that
+// can't be in one.
+static void dfa_path(Buffer *buf) {
+	trace_state(buf, LEX_NAME_NO_DELIM);
+
+	Buffer_read_ignore_whitespace(buf);
+
+	if (!is_class(buf->ch, CC_ALPHA))
+		Buffer_error(buf, "Invalid beginning character \"%c\" for name.", buf->ch);
+
+	const DfaRule *rule;
+	while (!is_line_end(buf->ch) && (rule = dfa_match(buf, MODE_NAME)) != NULL)
+		dfa_emit(buf, rule);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// What follows a directive's keyword. Directives missing here take nothing.
+static void dfa_directive(Buffer *buf, TokenType type) {
+	trace_state(buf, LEX_LOGIC);
+
+	switch (type) {
+	case IF:
+	case ELIF:
+		dfa_cond(buf);
+		break;
+	case FOR:
+	case ALIAS:
+		// A name, a binding keyword, and a name for -for or an ID for -alias.
+		Buffer_read_ignore_whitespace(buf);
+		if (!is_class(buf->ch, CC_ALPHA))
+			break;
+		dfa_path(buf);
+
+		Buffer_read_ignore_whitespace(buf);
+		if (!is_class(buf->ch, CC_ALPHA))
+			break;
+		dfa_binding(buf);
+
+		Buffer_read_ignore_whitespace(buf);
+		if (!is_class(buf->ch, CC_ALPHA))
+			break;
+		if (type == FOR) {
+			dfa_path(buf);
+		} else {
+			const DfaRule *rule = dfa_match(buf, MODE_IDENT);
+			dfa_emit(buf, rule);
+		}
+		break;
+	case EACH:
+		Buffer_read_ignore_whitespace(buf);
+		if (is_class(buf->ch, CC_ALPHA))
+			dfa_path(buf);
+		Buffer_read_ignore_whitespace(buf);
+		break;
+	default:
+		break;
+	}
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static void dfa_cond(Buffer *buf) {
+	trace_state(buf, LEX_IF);
+
+	while (!is_line_end(buf->ch)) {
+		Buffer_read_ignore_whitespace(buf);
+
+		const DfaRule *rule = dfa_match(buf, MODE_COND);
+		if (rule == NULL) {
+			if (buf->ch == '=' || buf->ch == '!')
+				Buffer_error(buf, "Invalid symbol \"%c\" found.", buf->ch);
+			Buffer_error(buf, "Invalid character \"%c\" in if-statment", buf->ch);
+		}
+
+		switch (rule->action) {
+		case ACTION_EMIT:
+			dfa_emit(buf, rule);
+			break;
+		case ACTION_PATH:
+			Buffer_unread(buf);
+			dfa_path(buf);
+			break;
+		default:
+			Buffer_error(buf, "No action for rule %d in this mode.", (int)(rule - dfa_rules));
+		}
+	}
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// The "in", "as" or "is" of -for and -alias; any other word is ILLEGAL.
+static void dfa_binding(Buffer *buf) {
+	trace_state(buf, LEX_KEYWORD);
+
+	dfa_emit(buf, dfa_match(buf, MODE_BINDING));
+}
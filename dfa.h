@@ -0,0 +1,23 @@
+#ifndef _MANANA_DFA_H
+#define _MANANA_DFA_H
+
+#include "lexer.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// The table-driven lexer. lexer.grammar lists the tokens looked for at each
+// place in a line (a mode) as regular expressions, and tools/gendfa turns
+// them into one DFA per mode in dfa_tables.h when manana is built. A match
+// is a table lookup per byte, after which the rule's action runs.
+//
+// Between matches, dfa.c does what the states in lexer.c do step for step:
+// where whitespace is skipped, which mode comes next and which errors are
+// raised. So the two lexers emit the same tokens, and a Buffer's state
+// (indent stack, filter block, resync points) means the same in either.
+// test/dfatest checks that they agree and bench/dfabench times both.
+//
+// Lexer_next runs dfa_initial in place of lex_initial for a Buffer whose
+// backend is LEXER_DFA (manana --lexer dfa).
+void dfa_initial(Buffer *buf);
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+#endif
@@ -1,85 +1,80 @@
+#include <stdio.h>
+#include <string.h>
 #include "indentation.h"
 #include "debug.h"
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
-IndentStack *IndentStack_create() {
-	return calloc(1, sizeof(IndentStack));
+// limit is the deepest the stack may get; 0 means MAX_INDENT.
+void IndentStack_init(IndentStack *stack, int limit, Arena *arena) {
+	stack->arena = arena;
+	stack->values = stack->inline_values;
+	stack->length = 0;
+	IndentStack_set_limit(stack, limit);
 }
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
-void IndentStack_increase(IndentStack *stack, int value) {
-	IndentNode *node = calloc(1, sizeof(IndentNode));
-	check_mem(node);
+// Change the limit of a stack that hasn't spilled yet, e.g. a Buffer's
+// before it is lexed.
+void IndentStack_set_limit(IndentStack *stack, int limit) {
+	stack->limit = limit > 0 ? limit : MAX_INDENT;
 
-	node->value = value; 
-	
-	if(stack->first == NULL) {
-		stack->first = node;
-		stack->last = node;
-	} else {
-		node->next = stack->first;
-		stack->first->prev = node;
-		stack->first = node;
-	}
-	
-	stack->length++;
-
-error:
-	return;
+	if (stack->values == stack->inline_values)
+		stack->max = stack->limit < INDENT_INLINE ? stack->limit : INDENT_INLINE;
 }
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
-void IndentStack_decrease(IndentStack *stack) {
-	IndentNode *node = stack->first;
+// Slow path of IndentStack_increase: move to (or grow) the heap copy,
+// doubling up to limit.
+int IndentStack_grow(IndentStack *stack) {
+	int *values = NULL;
 
-	if (node == NULL)
-		return;
+	if (stack->length >= stack->limit)
+		return -1;
 
-    check(stack->first && stack->last, "Indent stack is empty.");
-    check(node, "Indent stack node can't be NULL");
+	int max = stack->max * 2 < stack->limit ? stack->max * 2 : stack->limit;
 
-    if (node == stack->first && node == stack->last) {
-        stack->first = NULL;
-        stack->last = NULL;
-    } else if (node == stack->first) {
-        stack->first = node->next;
-        check(stack->first != NULL, "Invalid indent stack, *first is NULL.");
-        stack->first->prev = NULL;
-    } else if (node == stack->last) {
-        stack->last = node->prev;
-        check(stack->last != NULL, "Invalid indent stack, *next is NULL.");
-        stack->last->next = NULL;
-    } else {
-        IndentNode *after = node->next;
-        IndentNode *before = node->prev;
-        after->prev = before;
-        before->next = after;
-    }
+	if (stack->values == stack->inline_values) {
+		values = stack->arena ? Arena_alloc(stack->arena, max * sizeof(int)) : malloc(max * sizeof(int));
+		check_mem(values);
+		memcpy(values, stack->inline_values, stack->length * sizeof(int));
 
-    stack->length--;
-    free(node);
+		if (stack->arena)
+			mem_arena(stack->arena, MEM_INDENT, max * sizeof(int));
+		else
+			mem_alloc(MEM_INDENT, max * sizeof(int));
+	} else if (stack->arena) {
+		values = Arena_realloc(stack->arena, stack->values, stack->max * sizeof(int), max * sizeof(int));
+		check_mem(values);
+		mem_arena(stack->arena, MEM_INDENT, max * sizeof(int));
+	} else {
+		values = realloc(stack->values, max * sizeof(int));
+		check_mem(values);
+		mem_realloc(MEM_INDENT, stack->max * sizeof(int), max * sizeof(int));
+	}
 
+	stack->values = values;
+	stack->max = max;
+	return 0;
 error:
-    return;
+	return -1;
 }
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 void IndentStack_print(IndentStack *stack) {
+	int i;
+
 	printf("\t(%d) ==> [", stack->length);
-	INDENT_EACH(stack, first, next, cur) {
-		printf(" %d", (int)cur->value);
-	}
+	for (i = stack->length - 1; i >= 0; i--)
+		printf(" %d", stack->values[i]);
 	printf(" ]\n");
 }
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
-void IndentStack_destroy(IndentStack *stack) {
-	INDENT_EACH(stack, first, next, cur) {
-		if(cur->prev) {
-			free(cur->prev);
-		}
-	} 
-	
-	free(stack->last);
-	free(stack);
+void IndentStack_release(IndentStack *stack) {
+	if (stack->values != stack->inline_values && stack->arena == NULL) {
+		mem_free(MEM_INDENT, stack->max * sizeof(int));
+		free(stack->values);
+	}
+
+	IndentStack_init(stack, stack->limit, stack->arena);
 }
@@ -2,34 +2,63 @@
 #define _MANANA_INDENT_STACK_H
 
 #include <stdlib.h>
+#include "arena.h"
+#include "trace.h"
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
-struct IndentNode;
+// Indent levels kept inline for the common case; deeper nesting spills
+// to the heap.
+#define INDENT_INLINE 16
 
-typedef struct IndentNode {
-	struct IndentNode *prev, *next;
-	int value;
-} IndentNode;
+// Default nesting limit. Override with -DMAX_INDENT=n, or per stack with
+// IndentStack_set_limit.
+#ifndef MAX_INDENT
+#define MAX_INDENT 16
+#endif
 
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// The indentation of every open block, outermost first. values points at
+// inline_values until the stack grows past INDENT_INLINE, then at a copy in
+// arena (or on the heap without one) that is never larger than limit. The
+// stack lives inside its Buffer, so reading the current level is a load
+// from the Buffer itself.
 typedef struct IndentStack {
-	IndentNode *first, *last;
-	int length;
+	Arena *arena;
+	int *values;
+	int length, max, limit;
+	int inline_values[INDENT_INLINE];
 } IndentStack;
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
-IndentStack *IndentStack_create();
-void IndentStack_increase(IndentStack *stack, int value);
-void IndentStack_decrease(IndentStack *stack);
+void IndentStack_init(IndentStack *stack, int limit, Arena *arena);
+void IndentStack_set_limit(IndentStack *stack, int limit);
+int IndentStack_grow(IndentStack *stack);
 void IndentStack_print(IndentStack *stack);
-void IndentStack_destroy(IndentStack *stack);
+void IndentStack_release(IndentStack *stack);
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
-#define MAX_INDENT 16
+#define IndentStack_top(S) ((S)->values[(S)->length - 1])
+#define IndentStack_bottom(S) ((S)->values[0])
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Returns -1 if the stack is already limit levels deep or can't grow.
+static inline int IndentStack_increase(IndentStack *stack, int value) {
+	if (stack->length == stack->max && IndentStack_grow(stack) != 0)
+		return -1;
+
+	trace(TRACE_INDENT, INDENT_PUSH, value, stack->length, 0);
+	stack->values[stack->length++] = value;
+	return 0;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static inline void IndentStack_decrease(IndentStack *stack) {
+	if (stack->length == 0)
+		return;
 
-#define INDENT_EACH(STACK, FIRST, NEXT, CUR)\
-	IndentNode *_node = NULL;\
-	IndentNode *CUR = NULL;\
-    for (CUR = _node = STACK->FIRST; _node != NULL; CUR = _node = _node->NEXT)
+	stack->length--;
+	trace(TRACE_INDENT, INDENT_POP, stack->values[stack->length], stack->length, 0);
+}
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 #endif
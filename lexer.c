@@ -1,114 +1,406 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include <ctype.h>
+#include <stdarg.h>
 #include <string.h>
 #include "tokens.h"
 #include "lexer.h"
 #include "debug.h"
 #include "array.h"
-#include "sds.h"
+#include "scan.h"
+#include "charclass.h"
+#include "dfa.h"
 
+// The consume_* macros only move the buffer; the value they leave behind is
+// a slice of the source, so nothing is copied or allocated per token.
 #define consume_current()\
-	sds str = sdsnewlen(&buf->ch, 1);\
-	Buffer_set_value(buf, str);\
-	sdsfree(str);\
-	Buffer_read(buf);
+	buf->offset = buf->pos;\
+	Buffer_read(buf);\
+	Buffer_set_slice(buf, buf->offset);
 
 #define consume_while(x)\
-	sds str = sdsempty();\
-	int consume_counter = 0;\
+	buf->offset = buf->pos;\
 	while (x) {\
-		if (consume_counter > MANANA_MAX_TOKEN_LENGTH) {\
-			sdsfree(str);\
-			printf("Maximum value length of %d characters exceeded!\n", MANANA_MAX_TOKEN_LENGTH);\
-			exit(1);\
-		}\
-		str = sdscatlen(str, &buf->ch, 1);\
+		if (buf->pos - buf->offset > MANANA_MAX_TOKEN_LENGTH)\
+			Buffer_error(buf, "Maximum value length of %d characters exceeded!", MANANA_MAX_TOKEN_LENGTH);\
 		Buffer_read(buf);\
-		consume_counter++;\
 	}\
-	Buffer_set_value(buf, str);\
-	sdsfree(str);
+	Buffer_set_slice(buf, buf->offset);
+
+// Fast form of consume_while for character classes (see charclass.h).
+#define consume_class(mask)\
+	buf->offset = buf->pos;\
+	Buffer_jump(buf, span_class(buf->src + buf->pos, mask));\
+	Buffer_set_slice(buf, buf->offset);
 
 #define consume_chars(x)\
-	if (x > MANANA_MAX_TOKEN_LENGTH) {\
-		printf("Number provided to consume_chars is greater than allowed max of %d\n", MANANA_MAX_TOKEN_LENGTH);\
-		exit(1);\
-	}\
-	sds str = sdsempty();\
-	int consume_counter = 0;\
-	while (consume_counter < x) {\
-		str = sdscatlen(str, &buf->ch, 1);\
-		Buffer_read(buf);\
-		consume_counter++;\
-	}\
-	Buffer_set_value(buf, str);\
-	sdsfree(str);
+	if (x > MANANA_MAX_TOKEN_LENGTH)\
+		Buffer_error(buf, "Number provided to consume_chars is greater than allowed max of %d", MANANA_MAX_TOKEN_LENGTH);\
+	buf->offset = buf->pos;\
+	Buffer_jump(buf, x);\
+	Buffer_set_slice(buf, buf->offset);
+
+// Consume a run of text up to the next "@{", newline or EOF.
+#define consume_text()\
+	buf->offset = buf->pos;\
+	Buffer_jump(buf, scan_text(buf->src, buf->pos, buf->src_size + 1) - buf->pos);\
+	Buffer_set_slice(buf, buf->offset);
 
 #define str_is(a)\
-	(strcmp(buf->value, a) == 0)
+	(buf->length == sizeof(a) - 1 && memcmp(Buffer_value(buf), a, sizeof(a) - 1) == 0)
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
-void lex_initial(Buffer *buf) {
-	printf("(%d:%d) lex_initial\n", buf->line, buf->pos);
+#define LEXER_BACKEND_NAME(N, S) S,
+static const char *const lexer_backends[] = { LEXER_BACKENDS(LEXER_BACKEND_NAME) };
+#undef LEXER_BACKEND_NAME
 
-	Buffer_set_start(buf);
+const char *Lexer_backend_name(LexerBackend backend) {
+	return backend < LEXER_BACKEND_COUNT ? lexer_backends[backend] : "?";
+}
+
+// The backend called name, or -1.
+int Lexer_backend_find(const char *name) {
+	int i;
 
-	// Check for indent.
-	if (buf->ch == ' ' || buf->ch == '\t') {
-		lex_indent(buf); 
+	for (i = 0; i < LEXER_BACKEND_COUNT; i++) {
+		if (strcmp(lexer_backends[i], name) == 0)
+			return i;
 	}
-	// Check for tag.
-	else if (isalpha(buf->ch) || buf->ch == '.' || buf->ch == '#') {
-		lex_tag(buf);
+
+	return -1;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// The state lex_initial starts for the first character of a line, looked
+// up in initial_state instead of testing the character against each state
+// in turn. Three states need a second look before they're sure: ":" only
+// starts a filter before a letter, "@" a name before "{" and '"' a comment
+// as '"""'; otherwise the character is illegal.
+#define INITIAL_STATES(X)\
+	X(ILLEGAL) X(INDENT) X(TAG) X(LOGIC) X(FILTER) X(NAME) X(COMMENT)\
+	X(NEWLINE) X(END)
+
+#define INITIAL_ENUM(N) INITIAL_##N,
+typedef enum { INITIAL_STATES(INITIAL_ENUM) } InitialState;
+#undef INITIAL_ENUM
+
+static const uint8_t initial_state[256] = {
+	['\0'] = INITIAL_END,
+	['\n'] = INITIAL_NEWLINE,
+	[' '] = INITIAL_INDENT,
+	['\t'] = INITIAL_INDENT,
+	['A' ... 'Z'] = INITIAL_TAG,
+	['a' ... 'z'] = INITIAL_TAG,
+	['.'] = INITIAL_TAG,
+	['#'] = INITIAL_TAG,
+	['-'] = INITIAL_LOGIC,
+	[':'] = INITIAL_FILTER,
+	['@'] = INITIAL_NAME,
+	['"'] = INITIAL_COMMENT
+};
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+Buffer *Buffer_create(char *src, long src_size) {
+	return Buffer_create_in(src, src_size, NULL);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Allocate the Buffer's tokens from arena, which the caller keeps and may
+// reset once the Buffer is destroyed. With a NULL arena the Buffer makes
+// its own.
+Buffer *Buffer_create_in(char *src, long src_size, Arena *arena) {
+	Arena *owned_arena = NULL;
+	Buffer *buf = NULL;
+
+	if (arena == NULL) {
+		arena = owned_arena = Arena_create(0);
+		check_mem(arena);
 	}
-	// Check for logic.
-	else if (buf->ch == '-') {
-		lex_logic(buf);
+
+	buf = Arena_alloc(arena, sizeof(Buffer));
+	check_mem(buf);
+	memset(buf, 0, sizeof(Buffer));
+
+	buf->arena = arena;
+	buf->owned_arena = owned_arena;
+
+	buf->src = src;
+	buf->src_size = src_size;
+	buf->limit = src_size + 1;
+
+	buf->start = 0;
+	buf->pos = 0; 
+	buf->offset = 0;
+	buf->length = 0;
+	buf->value = NULL;
+	buf->ch = buf->src[buf->pos];
+	buf->next = buf->src[buf->pos+1];
+
+	buf->stream = TokenStream_create(buf->arena, src, src_size);
+	check_mem(buf->stream);
+	buf->filter_indent = -1;
+	buf->backend = LEXER_HAND;
+	buf->line = 1;
+
+	IndentStack_init(&buf->indent_stack, 0, buf->arena);
+	IndentStack_increase(&buf->indent_stack, 0); // Initialize Indent Stack to zero
+	buf->indent_level = 0;
+
+	return buf;
+error:
+	Arena_destroy(owned_arena);
+	return NULL;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// The Buffer lives in its own arena, so this is one free per arena chunk.
+// A Buffer made in the caller's arena has nothing to free, except a token
+// cache the stream was loaded from.
+void Buffer_destroy(Buffer *buf) {
+	if (buf->stream)
+		TokenStream_release(buf->stream);
+	Arena_destroy(buf->owned_arena);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+void Buffer_grow_pending(Buffer *buf) {
+	int max = buf->pending_max ? buf->pending_max * 2 : 64;
+
+	Token *pending = Arena_realloc(buf->arena, buf->pending, buf->pending_max * sizeof(Token), max * sizeof(Token));
+	check_mem(pending);
+	mem_arena(buf->arena, MEM_TOKENS, max * sizeof(Token));
+
+	buf->pending = pending;
+	buf->pending_max = max;
+	return;
+error:
+	Buffer_error(buf, "Out of memory.");
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Returns -1 if there's no memory for another resync point.
+int Buffer_push_resync(Buffer *buf, int offset, int index) {
+	if (buf->resync_count == buf->resync_max) {
+		int max = buf->resync_max ? buf->resync_max * 2 : 64;
+
+		ResyncPoint *resync = Arena_realloc(buf->arena, buf->resync,
+				buf->resync_max * sizeof(ResyncPoint), max * sizeof(ResyncPoint));
+		if (resync == NULL)
+			return -1;
+
+		buf->resync = resync;
+		buf->resync_max = max;
 	}
-	// Check for filter.
-	else if (buf->ch == ':' && isalpha(buf->next)) {
-		lex_filter(buf);
+
+	buf->resync[buf->resync_count].offset = offset;
+	buf->resync[buf->resync_count].index = index;
+	buf->resync_count++;
+	return 0;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// The symbol for tok's value, or SYM_NONE if it couldn't be interned. A
+// lazy value is expanded into scratch to be looked up, so it still isn't
+// materialized unless it's read.
+Symbol Buffer_intern(Buffer *buf, Token *tok) {
+	const char *value = Token_value(tok, buf->src);
+	int length = tok->length;
+
+	if (tok->lazy) {
+		length = Token_expand(tok, buf->src, buf->scratch);
+		value = buf->scratch;
 	}
-	// Check for name.
-	else if (buf->ch == '@' && buf->next == '{') {
-		lex_name(buf);
+
+	return SymbolTable_intern(buf->symbols, value, length);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Only the first error is kept; anything after it is fallout. Its line and
+// column are looked up here, since nothing counts them while lexing.
+static void Buffer_verror(Buffer *buf, const char *fmt, va_list args) {
+	if (buf->error)
+		return;
+
+	buf->error = 1;
+	buf->error_pos = buf->pos;
+
+	// Counted rather than indexed, so a Buffer read through Lexer_next
+	// doesn't build the whole file's line index for one error.
+	if (buf->stream->lines) {
+		buf->error_line = LineIndex_line(buf->stream->lines, buf->pos);
+		buf->error_column = LineIndex_column(buf->stream->lines, buf->pos);
+	} else {
+		int column = 1;
+
+		while (column <= buf->pos && buf->src[buf->pos - column] != '\n')
+			column++;
+		buf->error_line = scan_lines(buf->src, 0, buf->pos, NULL) + 1;
+		buf->error_column = column;
 	}
-	// Check for comment.
-	else if (buf->ch == '"' && buf->next == '"' && buf->src[buf->pos+1] == '"') {
-		lex_comment(buf);
+
+	vsnprintf(buf->error_message, sizeof(buf->error_message), fmt, args);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Record an error at the current position. Always returns -1.
+int Buffer_fail(Buffer *buf, const char *fmt, ...) {
+	va_list args;
+
+	va_start(args, fmt);
+	Buffer_verror(buf, fmt, args);
+	va_end(args);
+
+	return -1;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Record an error and unwind out of the current state. Only states run
+// by Lexer_next may call this; everything they allocate belongs to the
+// Buffer, so there is nothing to clean up on the way out.
+void Buffer_error(Buffer *buf, const char *fmt, ...) {
+	va_list args;
+
+	va_start(args, fmt);
+	Buffer_verror(buf, fmt, args);
+	va_end(args);
+
+	longjmp(buf->bail, 1);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+void Buffer_print(Buffer *buf) {
+	puts("\n  BUFFER ###########################################################");
+	printf("\tsrc_size: %ld\n", buf->src_size);
+	printf("\tstart: %d\n", buf->start);
+	printf("\tpos: %d\n", buf->pos);
+	printf("\tch: %c\n", buf->ch);
+	printf("\tnext: %c\n", buf->next);
+	printf("\tvalue: %.*s\n", buf->length, Buffer_value(buf));
+	printf("\tvalue length: %d\n", buf->length);
+	puts("  /BUFFER ###########################################################");
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+void Buffer_print_src(Buffer *buf) {
+	puts("\n  SOURCE ###########################################################");
+	printf("%s", buf->src);
+	puts("  /SOURCE ###########################################################");
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+void Buffer_print_tokens(Buffer *buf) {
+	puts("\n  TOKENS ###########################################################");
+	TOKENS_EACH(buf->stream, tok) {
+		Token_print(&tok, buf->src);
 	}
-	// Check for newline.
-	else if (buf->ch == '\n') {
-		buf->line++;
-		// ignore newline character itself by advancing buffer.
-		Buffer_jump(buf, 1); 
-		lex_indent(buf);
+	puts("  /TOKENS ###########################################################");
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+void Buffer_print_stream(Buffer *buf) {
+	puts("\n  STREAM ###########################################################");
+	TOKENS_EACH(buf->stream, tok) {
+		if (tok.type == INDENT || tok.type == DEDENT) {
+			printf("\t(%s\t %d)\n", tokens[tok.type], tok.length);
+		} else {
+			printf("\t(%s\t %.*s", tokens[tok.type], tok.length, Token_value(&tok, buf->src));
+			if (tok.symbol)
+				printf(" #%u", tok.symbol);
+			puts(")");
+		}
 	}
-	// Check for EOF.
-	else if (buf->ch == '\0') {
-		lex_eof(buf);
-		// Set buf->pos out of bounds to break tokenize function.
-		buf->pos++;
+	puts("\n  /STREAM ###########################################################");
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+void Buffer_print_loc(Buffer *buf) {
+	printf("\tstart: %d\n\tpos: %d\n", buf->start, buf->pos);
+	printf("\tch: %c\n", buf->ch);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+void Buffer_print_value(Buffer *buf) {
+	printf("\tvalue %.*s\n", buf->length, Buffer_value(buf));
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+void lex_initial(Buffer *buf) {
+	trace_state(buf, LEX_INITIAL);
+
+	Buffer_set_start(buf);
+
+	// Check for the next line of a filter block.
+	if (buf->filter_indent >= 0) {
+		lex_filter_line(buf);
+		return;
 	}
-	// No match. exit.
-	else {
-		printf("\tILLEGAL (%d:%d): %c\n", buf->line, buf->pos, buf->ch);
-		exit(1);
+
+	// One indexed jump to the state the first character starts.
+#if defined(__GNUC__) && !defined(MANANA_NO_COMPUTED_GOTO)
+#define INITIAL_TARGET(N) &&initial_##N,
+	static const void *const targets[] = { INITIAL_STATES(INITIAL_TARGET) };
+#undef INITIAL_TARGET
+	goto *targets[initial_state[(unsigned char)buf->ch]];
+#else
+#define INITIAL_TARGET(N) case INITIAL_##N: goto initial_##N;
+	switch ((InitialState)initial_state[(unsigned char)buf->ch]) {
+	INITIAL_STATES(INITIAL_TARGET)
 	}
+#undef INITIAL_TARGET
+#endif
+
+initial_INDENT:
+	lex_indent(buf); 
+	return;
+
+initial_TAG:
+	lex_tag(buf);
+	return;
+
+initial_LOGIC:
+	lex_logic(buf);
+	return;
+
+initial_FILTER:
+	if (!is_class(buf->next, CC_ALPHA))
+		goto initial_ILLEGAL;
+	lex_filter(buf);
+	return;
+
+initial_NAME:
+	if (buf->next != '{')
+		goto initial_ILLEGAL;
+	lex_name(buf);
+	return;
+
+initial_COMMENT:
+	if (buf->next != '"' || Buffer_peek(buf, 2) != '"')
+		goto initial_ILLEGAL;
+	lex_comment(buf);
+	return;
+
+initial_NEWLINE:
+	// ignore newline character itself by advancing buffer.
+	Buffer_jump(buf, 1); 
+	lex_indent(buf);
+	return;
+
+initial_END:
+	lex_eof(buf);
+	// Set buf->pos out of bounds to break tokenize function.
+	buf->pos++;
+	return;
+
+initial_ILLEGAL:
+	Buffer_error(buf, "Illegal character \"%c\".", buf->ch);
 } // end lex_initial()
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 void lex_indent(Buffer *buf) {
-	printf("(%d:%d) lex_indent\n", buf->line, buf->pos);
+	trace_state(buf, LEX_INDENT);
 
 	Buffer_set_start(buf);
 
-	// Allow for "empty indents"/dedents at level zero.
-	buf->value = sdsempty();
-	buf->length = 0;
-
-	consume_while(buf->ch == ' ' || buf->ch == '\t');
+	consume_class(CC_SPACE);
 
 	// Ignore blank lines.
 	if (buf->ch == '\n')
@@ -118,18 +410,16 @@ void lex_indent(Buffer *buf) {
 	// buf->length is set in consume_while macro.
 	int level = buf->length;
 
-	// Explicitly set value to empty string, we only need level now.
-	buf->value = sdsempty();
-
 	// Set appropriate indet level by increasing/descreasing stack.
 	if (level > INDENT_HIGHEST) {
-		IndentStack_increase(buf->indent_stack, level);
+		if (IndentStack_increase(&buf->indent_stack, level) != 0)
+			Buffer_error(buf, "Indentation nested deeper than %d levels.", buf->indent_stack.limit);
 		buf->indent_level = buf->length = level;
 		emit(buf, INDENT);
 	}
 	else if (level < INDENT_HIGHEST) {
 		while (INDENT_HIGHEST > level) {
-			IndentStack_decrease(buf->indent_stack);	
+			IndentStack_decrease(&buf->indent_stack);	
 			buf->indent_level = INDENT_HIGHEST;
 			buf->length = buf->indent_level;
 			emit(buf, DEDENT);
@@ -139,23 +429,22 @@ void lex_indent(Buffer *buf) {
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 void lex_tag(Buffer *buf) {
-	printf("(%d:%d) lex_tag\n", buf->line, buf->pos);
+	trace_state(buf, LEX_TAG);
 
 	Buffer_set_start(buf);
 
-	sds tag_name = sdsempty();
+	// Only "a" changes the src/href shorthand, so remember if that's the tag.
+	int is_anchor = 0;
 
 	// Check for div shorthand.
 	if (buf->ch == '.' || buf->ch == '#') {
-		sds str = sdsnew("div"); 
-		Buffer_set_value(buf, str); 
-		sdsfree(str); 
+		Buffer_set_value(buf, "div", 3);
 		emit(buf, TAG);
 
 	// Consume tag.
 	} else {
-		consume_while(isalpha(buf->ch) || isdigit(buf->ch));
-		tag_name = sdsnew(buf->value);
+		consume_class(CC_ALNUM);
+		is_anchor = str_is("a");
 		emit(buf, TAG);
 	}
 
@@ -194,19 +483,22 @@ void lex_tag(Buffer *buf) {
 
 				Buffer_read_ignore_whitespace(buf);
 
-				if (strcmp(tag_name, "a") == 0)
-					Buffer_set_value(buf, sdsnew("href"));
+				if (is_anchor)
+					Buffer_set_value(buf, "href", 4);
 				else
-					Buffer_set_value(buf, sdsnew("src"));
+					Buffer_set_value(buf, "src", 3);
 				emit(buf, ATTRKEY);
 
-				Buffer_set_value(buf, sdsnew("="));
+				Buffer_set_value(buf, "=", 1);
 				emit(buf, ATTREQ);
 
 				if (buf->ch == '"' || buf->ch == '\'') {
 					lex_str(buf);
 				}
+				break;
 			}
+			// A "-" on its own starts text.
+			lex_tag_text(buf);
 			break;
 		default: // We have text.
 			lex_tag_text(buf);
@@ -217,35 +509,35 @@ void lex_tag(Buffer *buf) {
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 void lex_tag_id(Buffer *buf) {
-	printf("(%d:%d) lex_tag_id\n", buf->line, buf->pos);
+	trace_state(buf, LEX_TAG_ID);
 
 	Buffer_set_start(buf);
 
 	// First character to this function will always be "#", advance buffer.
 	Buffer_jump(buf, 1);
 
-	consume_while(isalpha(buf->ch) || isdigit(buf->ch) || buf->ch == '-' || buf->ch == '_');
+	consume_class(CC_CSS_NAME);
 
 	emit(buf, TAGID);
 }
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 void lex_tag_class(Buffer *buf) {
-	printf("(%d:%d) lex_tag_class\n", buf->line, buf->pos);
+	trace_state(buf, LEX_TAG_CLASS);
 
 	Buffer_set_start(buf);
 
 	// First character to this function will always be ".", advance buffer.
 	Buffer_jump(buf, 1);
 
-	consume_while(isalpha(buf->ch) || isdigit(buf->ch) || buf->ch == '-' || buf->ch == '_');
+	consume_class(CC_CSS_NAME);
 
 	emit(buf, TAGCLASS);
 }
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 void lex_tag_attrs(Buffer *buf) {
-	printf("(%d:%d) lex_tag_attrs\n", buf->line, buf->pos);
+	trace_state(buf, LEX_TAG_ATTRS);
 
 	Buffer_set_start(buf);
 
@@ -257,22 +549,19 @@ void lex_tag_attrs(Buffer *buf) {
 		Buffer_read_ignore_whitespace(buf);
 
 		// Check for attribute key.
-		if (isalpha(buf->ch)) {
-			consume_while(isalpha(buf->ch) || isdigit(buf->ch) || buf->ch == '-' || buf->ch == '_');
+		if (is_class(buf->ch, CC_ALPHA)) {
+			consume_class(CC_CSS_NAME);
 			emit(buf, ATTRKEY);
 		}
 		// Check for data attribute key shorthand.
 		else if (buf->ch == '*') {
 			Buffer_jump(buf, 1);
 
-			sds str = sdsnew("data-");
-			while (isalpha(buf->ch) || isdigit(buf->ch) || buf->ch == '-' || buf->ch == '_') {
-				str = sdscatlen(str, &buf->ch, 1);
-				Buffer_read(buf);
-			}
+			consume_class(CC_CSS_NAME);
 
-			Buffer_set_value(buf, str);
-			sdsfree(str);
+			// The "data-" prefix isn't in the source; it's added when the
+			// value is materialized.
+			Buffer_set_lazy(buf, buf->offset, LAZY_DATA_KEY, buf->length + 5);
 
 			emit(buf, ATTRKEY);
 		} 
@@ -287,8 +576,11 @@ void lex_tag_attrs(Buffer *buf) {
 		}
 		// Check for EOF.
 		else if (buf->ch == '\0') {
-			printf("Unclosed tag attributes!\n");
-			exit(1);
+			Buffer_error(buf, "Unclosed tag attributes!");
+		}
+		// Anything else would never be consumed.
+		else if (buf->ch != ')') {
+			Buffer_error(buf, "Invalid character \"%c\" in tag attributes.", buf->ch);
 		}
 	}
 
@@ -297,14 +589,14 @@ void lex_tag_attrs(Buffer *buf) {
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 void lex_tag_inline_vars(Buffer *buf) {
-	printf("(%d:%d) lex_tag_inline_vars\n", buf->line, buf->pos);
+	trace_state(buf, LEX_TAG_INLINE_VARS);
 
 	Buffer_set_start(buf);
 
 	Buffer_jump(buf, 1); // Jump past initial "=" char. 
 	Buffer_read_ignore_whitespace(buf);
 
-	if (isalpha(buf->ch)) {
+	if (is_class(buf->ch, CC_ALPHA)) {
 		lex_name_no_delim(buf); 
 		Buffer_read_ignore_whitespace(buf);
 	}
@@ -312,25 +604,20 @@ void lex_tag_inline_vars(Buffer *buf) {
 	if (buf->ch != '\n' && buf->ch != '\0') {
 		consume_while(buf->ch != '\n' && buf->ch != '\0');
 		emit(buf, ILLEGAL);
-		printf("Invalid inline variable.\n");
-		exit(1);
+		Buffer_error(buf, "Invalid inline variable.");
 	}
 }
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 void lex_tag_text(Buffer *buf) {
-	printf("(%d:%d) lex_tag_text\n", buf->line, buf->pos);
+	trace_state(buf, LEX_TAG_TEXT);
 
 	Buffer_set_start(buf);
 	Buffer_read_ignore_whitespace(buf);
 
 	while (buf->ch != '\n' && buf->ch != '\0') {
 		// Lex raw text.
-		consume_while(
-			(buf->ch != '@' && buf->next != '{') 
-			&& buf->ch != '\n' 
-			&& buf->ch != '\0'
-		);
+		consume_text();
 		emit(buf, TAGTEXT);
 
 		// Lex interpolated name.
@@ -341,18 +628,14 @@ void lex_tag_text(Buffer *buf) {
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 void lex_text(Buffer *buf) {
-	printf("(%d:%d) lex_text\n", buf->line, buf->pos);
+	trace_state(buf, LEX_TEXT);
 
 	Buffer_set_start(buf);
 	Buffer_read_ignore_whitespace(buf);
 
 	while (buf->ch != '\n' && buf->ch != '\0') {
 		// Lex raw text.
-		consume_while(
-			(buf->ch != '@' && buf->next != '{') 
-			&& buf->ch != '\n' 
-			&& buf->ch != '\0'
-		);
+		consume_text();
 		emit(buf, TEXT);
 
 		// Lex interpolated name.
@@ -363,12 +646,10 @@ void lex_text(Buffer *buf) {
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 void lex_name(Buffer *buf) {
-	printf("(%d:%d) lex_name\n", buf->line, buf->pos);
+	trace_state(buf, LEX_NAME);
 
-	if (buf->ch != '@') {
-		printf("Invalid beginning character \"%c\" for name.", buf->ch);
-		exit(1);
-	}
+	if (buf->ch != '@')
+		Buffer_error(buf, "Invalid beginning character \"%c\" for name.", buf->ch);
 
 	Buffer_jump(buf, 2); // Ignore "@{" delimiter. 
 	Buffer_read_ignore_whitespace(buf);
@@ -377,8 +658,8 @@ void lex_name(Buffer *buf) {
 	while (buf->ch != '}' && buf->ch != '\0') {
 		Buffer_read_ignore_whitespace(buf);
 
-		if (isalpha(buf->ch) || buf->ch == '_') {
-			consume_while(isalpha(buf->ch) || buf->ch == '_' || isdigit(buf->ch));
+		if (is_class(buf->ch, CC_IDENT_START)) {
+			consume_class(CC_IDENT);
 			emit(buf, ID);
 		}
 		else if (buf->ch == '.') {
@@ -393,13 +674,16 @@ void lex_name(Buffer *buf) {
 			consume_current();
 			emit(buf, RBRACK);
 		}
-		else if (isdigit(buf->ch)) {
-			consume_while(isdigit(buf->ch));
+		else if (is_class(buf->ch, CC_DIGIT)) {
+			consume_class(CC_DIGIT);
 			emit(buf, INT);
 		}  
 		else if (buf->ch == '\n') {
-			printf("Invalid name! Newline found inside name declaration.\n");
-			exit(1);
+			Buffer_error(buf, "Invalid name! Newline found inside name declaration.");
+		}
+		// Anything else would never be consumed.
+		else if (buf->ch != '}' && buf->ch != '\0') {
+			Buffer_error(buf, "Invalid character \"%c\" in name.", buf->ch);
 		}
 	}
 
@@ -408,19 +692,17 @@ void lex_name(Buffer *buf) {
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 void lex_name_no_delim(Buffer *buf) {
-	printf("(%d:%d) lex_name_no_delim\n", buf->line, buf->pos);
+	trace_state(buf, LEX_NAME_NO_DELIM);
 
 	Buffer_read_ignore_whitespace(buf);
 	Buffer_set_start(buf);
 
-	if (!isalpha(buf->ch)) {
-		printf("Invalid beginning character \"%c\" for name.", buf->ch);
-		exit(1);
-	}
+	if (!is_class(buf->ch, CC_ALPHA))
+		Buffer_error(buf, "Invalid beginning character \"%c\" for name.", buf->ch);
 
 	while (buf->ch != '\n' && buf->ch != '\0') {
-		if (isalpha(buf->ch) || buf->ch == '_') {
-			consume_while(isalpha(buf->ch) || buf->ch == '_' || isdigit(buf->ch));
+		if (is_class(buf->ch, CC_IDENT_START)) {
+			consume_class(CC_IDENT);
 			emit(buf, ID);
 		}
 		else if (buf->ch == '.') {
@@ -435,8 +717,8 @@ void lex_name_no_delim(Buffer *buf) {
 			consume_current();
 			emit(buf, RBRACK);
 		}
-		else if (isdigit(buf->ch)) {
-			consume_while(isdigit(buf->ch));
+		else if (is_class(buf->ch, CC_DIGIT)) {
+			consume_class(CC_DIGIT);
 			emit(buf, INT);
 		} else {
 			break;
@@ -446,7 +728,7 @@ void lex_name_no_delim(Buffer *buf) {
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 void lex_str(Buffer *buf) {
-	printf("(%d:%d) lex_str\n", buf->line, buf->pos);
+	trace_state(buf, LEX_STR);
 
 	// Store single vs double quote to use as delimiter.
 	char quote = buf->ch;
@@ -454,31 +736,30 @@ void lex_str(Buffer *buf) {
 	Buffer_jump(buf, 1); // Advance past opening quote.
 	Buffer_set_start(buf);
 
-	sds str = sdsempty();
+	int from = buf->pos;
+	int escapes = 0;
 	int is_interpolated = 0;
-	char prev;
 
 	for (;;) {
 		// Check for name.
 		if (buf->ch == '@' && buf->next == '{') {
 			is_interpolated = 1;
 
-			Buffer_set_value(buf, str); 
+			Buffer_set_str(buf, from, quote, escapes);
 			emit(buf, ISTR);
-			str = sdsempty();
+			escapes = 0;
 
 			lex_name(buf);
+			from = buf->pos;
 		}
 		// Check for escaped quote.
 		else if (buf->ch == '\\' && buf->next == quote) {
-			str = sdscatlen(str, &buf->ch, 1);
-			str = sdscatlen(str, &buf->next, 1);
-
+			escapes++;
 			Buffer_jump(buf, 2);
 		}
 		// Check for end quote.
 		else if (buf->ch == quote) {
-			Buffer_set_value(buf, str);
+			Buffer_set_str(buf, from, quote, escapes);
 
 			if (is_interpolated)
 				emit(buf, ISTR);
@@ -490,18 +771,14 @@ void lex_str(Buffer *buf) {
 		}
 		// Check for EOF.
 		else if (buf->ch == '\0') {
-			printf("Unclosed string!");
-			exit(1);
+			Buffer_error(buf, "Unclosed string!");
 		}
 		// Continue consuming string.
 		else {
-			str = sdscatlen(str, &buf->ch, 1);
 			Buffer_read(buf);
 		}
 	}
 
-	sdsfree(str);
-
 	// Advance past closing quote.
 	if (buf->ch == quote)
 		Buffer_jump(buf, 1);
@@ -509,89 +786,74 @@ void lex_str(Buffer *buf) {
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 void lex_comment(Buffer *buf) {
-	printf("(%d:%d) lex_comment\n", buf->line, buf->pos);
+	trace_state(buf, LEX_COMMENT);
 
 	Buffer_set_start(buf);
-	Buffer_jump(buf, 2); // advance buffer past (""")
+	Buffer_jump(buf, 3); // advance buffer past (""")
 
-	for (;;) {
-		if (buf->ch == '"' && buf->next == '"' && buf->src[buf->pos+1] == '"')
-			break;
-		Buffer_read(buf);
-	}
+	Buffer_jump(buf, scan_comment(buf->src, buf->pos, buf->src_size + 1) - buf->pos);
+
+	if (buf->ch == '\0')
+		Buffer_error(buf, "Unclosed comment!");
 
 	Buffer_jump(buf, 3); // advance buffer past closing (""")
 }
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 void lex_logic(Buffer *buf) {
-	printf("(%d:%d) lex_logic\n", buf->line, buf->pos);
+	trace_state(buf, LEX_LOGIC);
 
 	Buffer_jump(buf, 1);
 	Buffer_set_start(buf);
 
-	consume_while(isalpha(buf->ch));
+	consume_class(CC_ALPHA);
+
+	TokenType type = keyword_lookup(Buffer_value(buf), buf->length, KW_DIRECTIVE);
+	emit(buf, type);
 
 	// redirect to appropriate substate.
-	if      (str_is("if"     )) { emit(buf, IF)     ; lex_if(buf)     ; }
-	else if (str_is("elif"   )) { emit(buf, ELIF)   ; lex_if(buf)     ; }
-	else if (str_is("else"   )) { emit(buf, ELSE)                     ; }
-	else if (str_is("case"   )) { emit(buf, CASE)   ; lex_case(buf)   ; }
-	else if (str_is("when"   )) { emit(buf, WHEN)   ; lex_when(buf)   ; }
-	else if (str_is("for"    )) { emit(buf, FOR)    ; lex_for(buf)    ; }
-	else if (str_is("each"   )) { emit(buf, EACH)   ; lex_each(buf)   ; }
-	else if (str_is("alias"  )) { emit(buf, ALIAS)  ; lex_alias(buf)  ; }
-	else if (str_is("unalias")) { emit(buf, UNALIAS); lex_unalias(buf); }
-	else if (str_is("include")) { emit(buf, INCLUDE); lex_include(buf); }
-	else if (str_is("with"   )) { emit(buf, WITH)   ; lex_with(buf)   ; }
-	else                        { emit(buf, ILLEGAL);                   }
+	switch (type) {
+	case IF:      lex_if(buf)     ; break;
+	case ELIF:    lex_if(buf)     ; break;
+	case CASE:    lex_case(buf)   ; break;
+	case WHEN:    lex_when(buf)   ; break;
+	case FOR:     lex_for(buf)    ; break;
+	case EACH:    lex_each(buf)   ; break;
+	case ALIAS:   lex_alias(buf)  ; break;
+	case UNALIAS: lex_unalias(buf); break;
+	case INCLUDE: lex_include(buf); break;
+	case WITH:    lex_with(buf)   ; break;
+	default:                        break;
+	}
 }
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 void lex_if(Buffer *buf) { 
-	printf("(%d:%d) lex_if\n", buf->line, buf->pos);
+	trace_state(buf, LEX_IF);
 
 	while (buf->ch != '\n' && buf->ch != '\0') {
 		Buffer_read_ignore_whitespace(buf);
 		Buffer_set_start(buf);
 
 		// Check for type, keyword, or name.
-		if (isalpha(buf->ch)) {
-			consume_while(isalpha(buf->ch));
-
-			// Check for type.
-			if (buf->value[0] >= 'A' && buf->value[0] <= 'Z') {
-				if      (str_is("Hash"))    emit(buf, TYPEHASH);
-				else if (str_is("List"))    emit(buf, TYPELIST);
-				else if (str_is("String"))  emit(buf, TYPESTRING);
-				else if (str_is("Int"))     emit(buf, TYPEINT);
-				else if (str_is("Number"))  emit(buf, TYPENUMBER);
-				else if (str_is("Boolean")) emit(buf, TYPEBOOLEAN);
-				// No match, assume name.
-				else {
-					Buffer_unread(buf);
-					lex_name_no_delim(buf);
-				}
-			// Check for keyword.
-			} else {
-				if (str_is("in"))
-					emit(buf, IN);
-				else if (str_is("is"))
-					emit(buf, IS);
-				else if (str_is("not"))
-					emit(buf, NOT);
-				else if (str_is("exists"))
-					emit(buf, EXISTS);
-				// No match, assume name.
-				else {
-					Buffer_unread(buf);
-					lex_name_no_delim(buf);
-				}
+		if (is_class(buf->ch, CC_ALPHA)) {
+			consume_class(CC_ALPHA);
+
+			// Check for type or keyword.
+			TokenType type = keyword_lookup(Buffer_value(buf), buf->length, KW_TYPE | KW_CONDITION);
+
+			if (type != ILLEGAL) {
+				emit(buf, type);
+			}
+			// No match, assume name.
+			else {
+				Buffer_unread(buf);
+				lex_name_no_delim(buf);
 			}
 		}
 		// Check for number.
-		else if (isdigit(buf->ch)) {
-			consume_while(isdigit(buf->ch) || buf->ch == '.');
+		else if (is_class(buf->ch, CC_DIGIT)) {
+			consume_class(CC_NUMBER);
 			emit(buf, NUMBER);
 		}
 		// Check for condition.
@@ -602,8 +864,7 @@ void lex_if(Buffer *buf) {
 					consume_chars(2);
 					emit(buf, EQ);
 				} else {
-					printf("Invalid symbol \"=\" found.\n");
-					exit(1);
+					Buffer_error(buf, "Invalid symbol \"=\" found.");
 				}
 				break;
 			case '!': // "!="
@@ -611,8 +872,7 @@ void lex_if(Buffer *buf) {
 					consume_chars(2);
 					emit(buf, NEQ);
 				} else {
-					printf("Invalid symbol \"!\" found.\n");
-					exit(1);
+					Buffer_error(buf, "Invalid symbol \"!\" found.");
 				}
 				break;
 			case '>': // ">" and ">="
@@ -634,13 +894,11 @@ void lex_if(Buffer *buf) {
 				}
 				break;
 			case '%': // "%" 
-				Buffer_set_value(buf, "%");
+				consume_current();
 				emit(buf, MOD);
-				Buffer_read(buf);
 				break;
 			default: 
-				printf("Invalid character \"%c\" in if-statment\n", buf->ch);
-				exit(1);
+				Buffer_error(buf, "Invalid character \"%c\" in if-statment", buf->ch);
 			}
 		}
 	}
@@ -648,22 +906,22 @@ void lex_if(Buffer *buf) {
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 void lex_for(Buffer *buf) { 
-	printf("(%d:%d) lex_for\n", buf->line, buf->pos);
+	trace_state(buf, LEX_FOR);
 
 	Buffer_read_ignore_whitespace(buf);
 	Buffer_set_start(buf);
 
-	if (isalpha(buf->ch)) {
+	if (is_class(buf->ch, CC_ALPHA)) {
 		lex_name_no_delim(buf);
 
 		Buffer_read_ignore_whitespace(buf);
 
-		if (isalpha(buf->ch)) {
+		if (is_class(buf->ch, CC_ALPHA)) {
 			lex_keyword(buf);
 
 			Buffer_read_ignore_whitespace(buf);
 
-			if (isalpha(buf->ch)) {
+			if (is_class(buf->ch, CC_ALPHA)) {
 				lex_name_no_delim(buf);
 			}
 		}
@@ -672,12 +930,12 @@ void lex_for(Buffer *buf) {
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 void lex_each(Buffer *buf) { 
-	printf("(%d:%d) lex_each\n", buf->line, buf->pos);
+	trace_state(buf, LEX_EACH);
 
 	Buffer_read_ignore_whitespace(buf);
 	Buffer_set_start(buf);
 
-	if (isalpha(buf->ch))
+	if (is_class(buf->ch, CC_ALPHA))
 		lex_name_no_delim(buf);
 
 	Buffer_read_ignore_whitespace(buf);
@@ -685,33 +943,33 @@ void lex_each(Buffer *buf) {
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 void lex_case(Buffer *buf) { 
-	printf("(%d:%d) lex_case\n", buf->line, buf->pos);
+	trace_state(buf, LEX_CASE);
 }
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 void lex_when(Buffer *buf) { 
-	printf("(%d:%d) lex_when\n", buf->line, buf->pos);
+	trace_state(buf, LEX_WHEN);
 }
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 void lex_with(Buffer *buf) { 
-	printf("(%d:%d) lex_with\n", buf->line, buf->pos);
+	trace_state(buf, LEX_WITH);
 }
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 void lex_alias(Buffer *buf) {
-	printf("(%d:%d) lex_alias\n", buf->line, buf->pos);
+	trace_state(buf, LEX_ALIAS);
 
 	Buffer_read_ignore_whitespace(buf);
-	if (isalpha(buf->ch)) {
+	if (is_class(buf->ch, CC_ALPHA)) {
 		lex_name_no_delim(buf);
 
 		Buffer_read_ignore_whitespace(buf);
-		if (isalpha(buf->ch)) {
+		if (is_class(buf->ch, CC_ALPHA)) {
 			lex_keyword(buf); 
 			
 			Buffer_read_ignore_whitespace(buf);
-			if (isalpha(buf->ch))
+			if (is_class(buf->ch, CC_ALPHA))
 				lex_id(buf);
 		}
 	}
@@ -719,118 +977,127 @@ void lex_alias(Buffer *buf) {
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 void lex_unalias(Buffer *buf) { 
-	printf("(%d:%d) lex_unalias\n", buf->line, buf->pos);
+	trace_state(buf, LEX_UNALIAS);
 }
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 void lex_include(Buffer *buf) {
-	printf("(%d:%d) lex_include\n", buf->line, buf->pos);
+	trace_state(buf, LEX_INCLUDE);
 }
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 void lex_filter(Buffer *buf) {
-	printf("(%d:%d) lex_filter\n", buf->line, buf->pos);
+	trace_state(buf, LEX_FILTER);
 
 	Buffer_jump(buf, 1); // Advance past initial ":"
 
-	consume_while(isalpha(buf->ch) || isdigit(buf->ch) || buf->ch == '_');
+	consume_class(CC_IDENT);
 	emit(buf, FILTER);
 
+	if (lex_filter_open(buf))
+		lex_text(buf);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// After a filter's name: a name that ends its line opens a block. Returns
+// 1 if text follows the name instead.
+int lex_filter_open(Buffer *buf) {
 	Buffer_read_ignore_whitespace(buf);
 
 	// Check for block.
 	if (buf->ch == '\n') {
-		buf->line++;
 		Buffer_jump(buf, 1); // ignore newline character. 
 		Buffer_set_start(buf);
 
 		// Store indent level for block to compare.
-		int filter_base_indent;
-		consume_while(buf->ch == ' ' || buf->ch == '\t');
-		filter_base_indent = buf->length;
+		consume_class(CC_SPACE);
+		buf->filter_indent = buf->length;
 
-		// Set buffer back before initial indent.
+		// Set buffer back before initial indent. The block's lines are
+		// lexed one per step by lex_filter_line.
 		Buffer_unread(buf);
+		return 0;
+	}
 
-		// Get lines.
-		while (buf->ch != '\0') {
-			Buffer_set_start(buf);
+	// Text, unless it's EOF.
+	return buf->ch != '\0';
+}
 
-			// Check for next line.
-			if (buf->ch == '\n') {
-				buf->line++;
-				Buffer_read(buf);
-				Buffer_set_start(buf);
-			}
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+void lex_filter_line(Buffer *buf) {
+	trace_state(buf, LEX_FILTER);
 
-			// Get line indent.
-			consume_while(buf->ch == ' ' || buf->ch == '\t');
-
-			if (buf->length > filter_base_indent) {
-				sdsrange(buf->value, filter_base_indent, -1);
-				Buffer_set_value(buf, buf->value);
-				emit(buf, TEXT);
-			} 
-			else if (buf->length < filter_base_indent) {
-				buf->indent_level = INDENT_HIGHEST;
-				buf->length = buf->indent_level;
-				emit(buf, DEDENT);
-				return;
-			}
+	if (lex_filter_indent(buf)) {
+		Buffer_set_start(buf);
+		lex_text(buf);
+	}
+}
 
-			// Get line text.
-			Buffer_set_start(buf);
-			lex_text(buf);
-		}
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// The indentation of the next line of a filter block. What's beyond the
+// block's own is text; less ends the block, as does EOF. Returns 1 if the
+// line's text comes next.
+int lex_filter_indent(Buffer *buf) {
+	// Block ends at EOF.
+	if (buf->ch == '\0') {
+		buf->filter_indent = -1;
+		return 0;
 	}
-	// Check for EOF.
-	else if (buf->ch == '\0') {
-		return;
+
+	// Check for next line.
+	if (buf->ch == '\n') {
+		Buffer_read(buf);
+		Buffer_set_start(buf);
 	}
-	// Consume text. 
-	else {
-		lex_text(buf);
+
+	// Get line indent.
+	consume_class(CC_SPACE);
+
+	if (buf->length > buf->filter_indent) {
+		// Keep only the indentation beyond the block's own.
+		Buffer_set_slice(buf, buf->offset + buf->filter_indent);
+		emit(buf, TEXT);
+	} 
+	else if (buf->length < buf->filter_indent) {
+		buf->indent_level = INDENT_HIGHEST;
+		buf->length = buf->indent_level;
+		emit(buf, DEDENT);
+		buf->filter_indent = -1;
+		return 0;
 	}
+
+	// Get line text.
+	return 1;
 }
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 void lex_keyword(Buffer *buf) {
-	printf("(%d:%d) lex_keyword\n", buf->line, buf->pos);
+	trace_state(buf, LEX_KEYWORD);
 
-	consume_while(isalpha(buf->ch));
+	consume_class(CC_ALPHA);
 
-	if      (str_is("in")) emit(buf, IN);
-	else if (str_is("as")) emit(buf, AS);
-	else if (str_is("is")) emit(buf, IS);
-	else                   emit(buf, ILLEGAL);
+	emit(buf, keyword_lookup(Buffer_value(buf), buf->length, KW_BINDING));
 }
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 void lex_id(Buffer *buf) {
-	printf("(%d:%d) lex_id\n", buf->line, buf->pos);
-
-	consume_while(isalpha(buf->ch) || isdigit(buf->ch) || buf->ch == '_');
+	trace_state(buf, LEX_ID);
 
-	Buffer_set_value(buf, str);
+	consume_class(CC_IDENT);
 
 	emit(buf, ID);
 }
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 void lex_eof(Buffer *buf) {
-	printf("(%d:%d) lex_eof\n", buf->line, buf->pos);
+	trace_state(buf, LEX_EOF);
 
-	int initial_indent;
-	if (buf->stream[0]->type == INDENT) 
-		initial_indent = buf->stream[0]->length;
-	else
-		initial_indent = 0;
+	int initial_indent = buf->initial_indent;
 
-	buf->value = "";
-	buf->value = sdsempty();
+	Buffer_set_slice(buf, buf->pos);
 
 	while (INDENT_HIGHEST > initial_indent) {
-		IndentStack_decrease(buf->indent_stack);
+		IndentStack_decrease(&buf->indent_stack);
 		buf->indent_level = INDENT_HIGHEST;
 		buf->length = INDENT_HIGHEST;
 		emit(buf, DEDENT);
@@ -838,37 +1105,86 @@ void lex_eof(Buffer *buf) {
 }
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
-int tokenize(char *src, int src_size) {
-	Buffer *buf = Buffer_create(src, src_size);
+// Lexer_next, but lazy values and lines are left for whoever reads the
+// token. Kept out of line: inlined, its setjmp ends up inside tokenize's
+// loop and costs every token a spill.
+__attribute__((noinline))
+static int Lexer_next_lazy(Buffer *buf, Token *tok) {
+	if (buf->error)
+		return -1;
+
+	// Errors in the states below unwind to here.
+	if (setjmp(buf->bail) != 0) {
+		buf->pending_head = buf->pending_count = 0;
+		return -1;
+	}
 
-	while (buf->pos <= buf->src_size)
-		lex_initial(buf);
+	while (buf->pending_head == buf->pending_count) {
+		if (buf->pos >= buf->limit)
+			return 0;
 
-	//Buffer_print_tokens(buf);
-	Buffer_print_stream(buf);
+		if (buf->track_resync && Buffer_at_resync(buf) && Buffer_push_resync(buf, buf->pos, buf->emitted) != 0)
+			Buffer_error(buf, "Out of memory.");
 
-	Buffer_destroy(buf);
+		buf->pending_head = buf->pending_count = 0;
+		if (buf->backend == LEXER_DFA)
+			dfa_initial(buf);
+		else
+			lex_initial(buf);
+	}
 
+	*tok = buf->pending[buf->pending_head++];
 	return 1;
 }
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
-int main(int argc, char *argv[]) {
-	puts("\n");
+// Read the next token into tok. Returns 1 for a token, 0 once the source
+// is exhausted and -1 on error (see buf->error_message). Tokens come out as
+// the states produce them, so a consumer can start before the rest of the
+// template has been lexed.
+//
+// Nothing here grows with the source: the line is counted on from the
+// last token's, and a lazy value is left lazy (tok->lazy) for the caller
+// to read with Lexer_value or keep with Token_materialize.
+int Lexer_next(Buffer *buf, Token *tok) {
+	int rc = Lexer_next_lazy(buf, tok);
+	if (rc <= 0)
+		return rc;
+
+	if (tok->offset >= buf->line_pos)
+		buf->line += scan_lines(buf->src, buf->line_pos, tok->offset, NULL);
+	else
+		buf->line -= scan_lines(buf->src, tok->offset, buf->line_pos, NULL);
 
-	FILE *f = fopen("examples/0.basics.manana", "rb");
-	//FILE *f = fopen("examples/1.logic.manana", "rb");
+	buf->line_pos = tok->offset;
+	tok->line = buf->line;
+	return rc;
+}
 
-	fseek(f, 0, SEEK_END);
-	long src_size = ftell(f);
-	fseek(f, 0, SEEK_SET);
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Make the value of tok, the token Lexer_next just returned, readable. A
+// lazy one is expanded into scratch, so it's only good until the next
+// Lexer_next; Token_materialize copies it into the arena instead.
+void Lexer_value(Buffer *buf, Token *tok) {
+	if (tok->lazy == LAZY_NONE)
+		return;
 
-	char *src = malloc(src_size + 1);
-	fread(src, src_size, 1, f);
-	src[src_size] = '\0';
-	fclose(f);
+	tok->length = Token_expand(tok, buf->src, buf->scratch);
+	tok->value = buf->scratch;
+	tok->lazy = LAZY_NONE;
+}
 
-	tokenize(src, src_size);
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Lex the whole source into buf->stream. Returns the number of tokens, or
+// -1 on error, in which case the stream holds the tokens before it.
+int tokenize(Buffer *buf) {
+	Token tok;
+	int rc;
+
+	while ((rc = Lexer_next_lazy(buf, &tok)) > 0) {
+		if (TokenStream_push(buf->stream, &tok) != 0)
+			return Buffer_fail(buf, "Out of memory.");
+	}
 
-	return 0;
+	return rc < 0 ? -1 : TokenStream_count(buf->stream);
 }
@@ -1,46 +1,128 @@
 #ifndef _MANANA_LEXER_H
 #define _MANANA_LEXER_H
 
+#include <setjmp.h>
+
 #include "array.h"
+#include "arena.h"
 #include "indentation.h"
 #include "tokens.h"
-#include "sds.h"
+#include "stream.h"
+#include "trace.h"
+#include "charclass.h"
+#include "symbols.h"
+
+#define INDENT_HIGHEST IndentStack_top(&buf->indent_stack)
+#define INDENT_LOWEST IndentStack_bottom(&buf->indent_stack)
 
-#define INDENT_HIGHEST buf->indent_stack->first->value
-#define INDENT_LOWEST buf->indent_stack->last->value
+#define MANANA_MAX_TOKEN_LENGTH 1000
 
-static const int MANANA_MAX_TOKEN_LENGTH = 1000;
+#define MANANA_ERROR_LENGTH 128
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
-typedef struct Buffer {
-	IndentStack *indent_stack;
-	Token *stream[1000];
-	int line, start, pos, length, indent_level, stream_index;
-	char ch, next, *src, *value;
-	long src_size;
-} Buffer;
+// The lexers a Buffer can be lexed with: the states in lexer.c, or the
+// table-driven one generated from lexer.grammar (see dfa.h). Both produce
+// the same tokens.
+#define LEXER_BACKENDS(X)\
+	X(HAND, "hand")\
+	X(DFA,  "dfa")
+
+#define LEXER_BACKEND_ENUM(N, S) LEXER_##N,
+typedef enum { LEXER_BACKENDS(LEXER_BACKEND_ENUM) LEXER_BACKEND_COUNT } LexerBackend;
+#undef LEXER_BACKEND_ENUM
+
+const char *Lexer_backend_name(LexerBackend backend);
+int Lexer_backend_find(const char *name);
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
-Buffer *Buffer_create(char *src, long src_size) {
-	Buffer *buf = malloc(sizeof(Buffer));
+// A line the lexer started on in its initial state: column 0, something
+// other than whitespace there, indent stack [0] and no :filter block open.
+// index is how many tokens came before it. The lexer can start over from
+// one as if it were the top of the file (see relex.h).
+typedef struct ResyncPoint {
+	int offset, index;
+} ResyncPoint;
 
-	buf->src = src;
-	buf->src_size = src_size;
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// The current value is the slice src[offset, offset + length). When a state
+// has to imply a value that is not in the source, value points at it
+// instead; when the value is the slice read a different way, lazy says how
+// (see TokenLazy). scratch is where a lazy name is expanded to be interned.
+//
+// Everything a Buffer allocates, the Buffer itself included, comes from
+// arena and is freed all at once with the Buffer, unless the arena was
+// handed in by the caller (Buffer_create_in).
+//
+// States emit into pending, a queue that Lexer_next drains one token at a
+// time before it runs the next state; it only ever holds one step's worth
+// of tokens (usually one line). filter_indent is the indentation of the
+// :filter block being lexed, or -1 outside of one. Lexer_next stops once
+// pos reaches limit, which is past the end of src unless a caller lexes
+// only part of it (see split.c).
+//
+// symbols, if set, is the table the names are interned in (see symbols.h).
+// The Buffer only borrows it, so one table can serve many Buffers.
+//
+// backend is the lexer that runs the steps, LEXER_HAND unless the caller
+// picks another before the first, as it does symbols.
+//
+// With track_resync set, every resync point the lexer steps from is kept
+// in resync, in order (see ResyncPoint and relex.h).
+//
+// Lines aren't counted while lexing. A stored token's line is looked up
+// from its offset in the stream's LineIndex. Lexer_next counts instead:
+// line is the line of offset line_pos, the last token it returned, so the
+// index is never built for a template that is only streamed. An error's
+// line and column are counted too, unless the index is already there.
+//
+// A Buffer holds all of the lexer's state, so any number of them can be
+// lexed at once on different threads. Errors don't exit: the state that
+// finds one calls Buffer_error, which records it in error_* and unwinds
+// through bail back to Lexer_next, and from then on the Buffer only ever
+// returns -1.
+typedef struct Buffer {
+	IndentStack indent_stack;
+	Arena *arena, *owned_arena;
+	TokenStream *stream;
+	SymbolTable *symbols;
+	Token *pending;
+	int pending_head, pending_count, pending_max;
+	int emitted, initial_indent, filter_indent;
+	int start, pos, offset, length, indent_level;
+	char ch, next, *src;
+	const char *value;
+	int lazy;
+	long src_size, limit;
+	ResyncPoint *resync;
+	int resync_count, resync_max, track_resync;
+	int line, line_pos;
+	int error, error_line, error_column, error_pos;
+	LexerBackend backend;
+	char error_message[MANANA_ERROR_LENGTH];
+	jmp_buf bail;
+	char scratch[MANANA_MAX_TOKEN_LENGTH + 1];
+} Buffer;
 
-	buf->line = 1;
-	buf->start = 0;
-	buf->pos = 0; 
-	buf->length = 0;
-	buf->value = "";
-	buf->ch = buf->src[buf->pos];
-	buf->next = buf->src[buf->pos+1];
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+Buffer *Buffer_create(char *src, long src_size);
+Buffer *Buffer_create_in(char *src, long src_size, Arena *arena);
+void Buffer_destroy(Buffer *buf);
+void Buffer_print(Buffer *buf);
+void Buffer_print_src(Buffer *buf);
+void Buffer_print_tokens(Buffer *buf);
+void Buffer_print_stream(Buffer *buf);
+void Buffer_print_loc(Buffer *buf);
+void Buffer_print_value(Buffer *buf);
 
-	buf->indent_stack = IndentStack_create();
-	IndentStack_increase(buf->indent_stack, 0); // Initialize Indent Stack to zero
-	buf->indent_level = 0;
+int Lexer_next(Buffer *buf, Token *tok);
+void Lexer_value(Buffer *buf, Token *tok);
+int tokenize(Buffer *buf);
 
-	return buf;
-}
+void Buffer_grow_pending(Buffer *buf);
+int Buffer_push_resync(Buffer *buf, int offset, int index);
+Symbol Buffer_intern(Buffer *buf, Token *tok);
+int Buffer_fail(Buffer *buf, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+void Buffer_error(Buffer *buf, const char *fmt, ...) __attribute__((noreturn, format(printf, 2, 3)));
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 static inline void Buffer_read(Buffer *buf) {
@@ -49,12 +131,6 @@ static inline void Buffer_read(Buffer *buf) {
 	buf->next = buf->src[buf->pos+1];
 }
 
-// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
-static inline void Buffer_read_ignore_whitespace(Buffer *buf) {
-	while (buf->ch == ' ' || buf->ch == '\t')
-		Buffer_read(buf);
-}
-
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 static inline void Buffer_unread(Buffer *buf) {
 	buf->pos = buf->start;
@@ -75,87 +151,81 @@ static inline void Buffer_jump(Buffer *buf, int inc) {
 }
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
-static inline void Buffer_set_start(Buffer *buf) {
-	buf->start = buf->pos;
+static inline void Buffer_read_ignore_whitespace(Buffer *buf) {
+	if (is_class(buf->ch, CC_SPACE))
+		Buffer_jump(buf, span_class(buf->src + buf->pos, CC_SPACE));
 }
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
-static inline void Buffer_set_value(Buffer *buf, char *str) {
-	buf->value = str;
-	buf->length = sdslen(str);
-
-	if (buf->length > MANANA_MAX_TOKEN_LENGTH) {
-		printf("Maximum value length of %d characters exceeded!\n", MANANA_MAX_TOKEN_LENGTH);
-		exit(1);
-	}
+// Whether the step about to run starts at a resync point. Only true
+// between steps.
+static inline int Buffer_at_resync(Buffer *buf) {
+	return buf->indent_stack.length == 1 && buf->filter_indent < 0
+		&& (buf->pos == 0 || buf->src[buf->pos - 1] == '\n')
+		&& buf->ch != '\n' && buf->ch != '\0' && !is_class(buf->ch, CC_SPACE);
 }
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
-static inline void Buffer_destroy(Buffer *buf) {
-	if (buf->indent_stack)
-		IndentStack_destroy(buf->indent_stack);
-	free(buf);
+static inline void Buffer_set_start(Buffer *buf) {
+	buf->start = buf->pos;
 }
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
-void Buffer_print(Buffer *buf) {
-    puts("\n  BUFFER ###########################################################");
-	printf("\tsrc_size: %ld\n", buf->src_size);
-	printf("\tline: %d\n", buf->line);
-	printf("\tstart: %d\n", buf->start);
-	printf("\tpos: %d\n", buf->pos);
-	printf("\tch: %c\n", buf->ch);
-	printf("\tnext: %c\n", buf->next);
-	printf("\tvalue: %s\n", buf->value);
-	printf("\tvalue length: %d\n", buf->length);
-    puts("  /BUFFER ###########################################################");
+static inline const char *Buffer_value(Buffer *buf) {
+	return buf->value ? buf->value : buf->src + buf->offset;
 }
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
-void Buffer_print_src(Buffer *buf) {
-    puts("\n  SOURCE ###########################################################");
-	printf("%s", buf->src);
-    puts("  /SOURCE ###########################################################");
+// Use everything between offset and the current position as the value.
+static inline void Buffer_set_slice(Buffer *buf, int offset) {
+	buf->value = NULL;
+	buf->lazy = LAZY_NONE;
+	buf->offset = offset;
+	buf->length = buf->pos - offset;
+
+	if (buf->length > MANANA_MAX_TOKEN_LENGTH)
+		Buffer_error(buf, "Maximum value length of %d characters exceeded!", MANANA_MAX_TOKEN_LENGTH);
 }
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
-void Buffer_print_tokens(Buffer *buf) {
-    puts("\n  TOKENS ###########################################################");
-    int i = 0;
-    Token *tok;
-    while ((tok = buf->stream[i])) {
-        Token_print(tok);
-        i++;
-    }
-    puts("  /TOKENS ###########################################################");
+// Use a value that is not in the source. str must outlive the Buffer,
+// a string literal, say.
+static inline void Buffer_set_value(Buffer *buf, const char *str, int length) {
+	buf->value = str;
+	buf->lazy = LAZY_NONE;
+	buf->offset = buf->start;
+	buf->length = length;
+
+	if (buf->length > MANANA_MAX_TOKEN_LENGTH)
+		Buffer_error(buf, "Maximum value length of %d characters exceeded!", MANANA_MAX_TOKEN_LENGTH);
 }
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
-void Buffer_print_stream(Buffer *buf) {
-    puts("\n  STREAM ###########################################################");
-    int i = 0;
-    Token *tok;
-    while ((tok = buf->stream[i])) {
-    	if (tok->type == INDENT || tok->type == DEDENT) {
-			printf("\t(%s\t %d)\n", tokens[tok->type], tok->length);
-		} else {
-			printf("\t(%s\t %s)\n", tokens[tok->type], tok->value);
-		}
-        i++;
-    }
-    puts("\n  /STREAM ###########################################################");
+// Use src[offset, pos), read as lazy says, as the value. length is how
+// long the value will be once it's materialized.
+static inline void Buffer_set_lazy(Buffer *buf, int offset, int lazy, int length) {
+	if (length > MANANA_MAX_TOKEN_LENGTH)
+		Buffer_error(buf, "Maximum value length of %d characters exceeded!", MANANA_MAX_TOKEN_LENGTH);
+
+	buf->value = NULL;
+	buf->lazy = lazy;
+	buf->offset = offset;
+	buf->length = buf->pos - offset;
 }
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
-void Buffer_print_loc(Buffer *buf) {
-	printf("\tstart: %d\n\tpos: %d\n", buf->start, buf->pos);
-	printf("\tch: %c\n", buf->ch);
+// Set the value of a (piece of a) string that started at from, with
+// escapes escaped quotes in it. Unescaping is left until the value is
+// read, so the value is always the slice.
+static inline void Buffer_set_str(Buffer *buf, int from, char quote, int escapes) {
+	if (escapes == 0)
+		Buffer_set_slice(buf, from);
+	else
+		Buffer_set_lazy(buf, from, quote == '"' ? LAZY_DQUOTE : LAZY_SQUOTE, buf->pos - from - escapes);
 }
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
-void Buffer_print_value(Buffer *buf) {
-	printf("\tvalue %s\n", buf->value);
-}
+#define trace_state(BUF, STATE) trace(TRACE_LEXER, STATE, (BUF)->pos, (unsigned char)(BUF)->ch, 0)
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 void lex_initial(Buffer *buf);
@@ -184,15 +254,33 @@ void lex_alias(Buffer *buf);
 void lex_unalias(Buffer *buf);
 void lex_include(Buffer *buf);
 void lex_filter(Buffer *buf);
+void lex_filter_line(Buffer *buf);
+int lex_filter_open(Buffer *buf);
+int lex_filter_indent(Buffer *buf);
 void lex_id(Buffer *buf);
 void lex_keyword(Buffer *buf);
 void lex_eof(Buffer *buf);
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 static inline void emit(Buffer *buf, TokenType type) {
-	Token *tok = Token_new(type, buf->value, buf->length, buf->line, buf->start);
-	buf->stream[buf->stream_index] = tok;
-	buf->stream_index++;
+	if (buf->pending_count == buf->pending_max)
+		Buffer_grow_pending(buf);
+
+	Token *tok = &buf->pending[buf->pending_count++];
+	tok->type = type;
+	tok->line = 0;
+	tok->offset = buf->offset;
+	tok->length = buf->length;
+	tok->value = buf->value;
+	tok->lazy = buf->lazy;
+	tok->symbol = SYM_NONE;
+
+	if (buf->symbols && Token_has_symbol(type) && (tok->symbol = Buffer_intern(buf, tok)) == SYM_NONE)
+		Buffer_error(buf, "Out of memory.");
+
+	// lex_eof dedents back to the indentation the template started at.
+	if (buf->emitted++ == 0 && type == INDENT)
+		buf->initial_indent = buf->length;
 }
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
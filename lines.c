@@ -0,0 +1,49 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "debug.h"
+#include "lines.h"
+#include "scan.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Count the newlines first, so the index is allocated once at its size.
+LineIndex *LineIndex_create(const char *src, long size, Arena *arena) {
+	LineIndex *index = Arena_alloc(arena, sizeof(LineIndex));
+	check_mem(index);
+
+	index->count = scan_lines(src, 0, size, NULL) + 1;
+
+	index->starts = Arena_alloc(arena, index->count * sizeof(uint32_t));
+	check_mem(index->starts);
+	mem_arena(arena, MEM_LINES, sizeof(LineIndex) + index->count * sizeof(uint32_t));
+
+	index->starts[0] = 0;
+	scan_lines(src, 0, size, index->starts + 1);
+
+	return index;
+error:
+	return NULL;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// The last line that starts at or before offset.
+int LineIndex_line(const LineIndex *index, long offset) {
+	int lo = 0, hi = index->count;
+
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if ((long)index->starts[mid] <= offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Column of offset, counted in bytes from 1.
+int LineIndex_column(const LineIndex *index, long offset) {
+	int line = LineIndex_line(index, offset);
+
+	return line > 0 ? offset - index->starts[line - 1] + 1 : 0;
+}
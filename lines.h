@@ -0,0 +1,37 @@
+#ifndef _MANANA_LINES_H
+#define _MANANA_LINES_H
+
+#include <stdint.h>
+#include "arena.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Where every line of a source starts: starts[n] is the offset of line
+// n + 1, so starts[0] is 0. The lexer doesn't count lines as it goes; the
+// index is built in one pass over the source (see scan_lines) the first
+// time a line number is wanted, and an offset's line is then a binary
+// search.
+typedef struct LineIndex {
+	uint32_t *starts;
+	int count;
+} LineIndex;
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+LineIndex *LineIndex_create(const char *src, long size, Arena *arena);
+int LineIndex_line(const LineIndex *index, long offset);
+int LineIndex_column(const LineIndex *index, long offset);
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Line of offset, starting from line, the line of an earlier offset.
+// Walking forward through a source this is a compare or two per call.
+static inline int LineIndex_seek(const LineIndex *index, int line, long offset) {
+	if (line < 1 || offset < (long)index->starts[line - 1])
+		return LineIndex_line(index, offset);
+
+	while (line < index->count && (long)index->starts[line] <= offset)
+		line++;
+
+	return line;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+#endif
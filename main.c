@@ -0,0 +1,321 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include "batch.h"
+#include "cache.h"
+#include "lexer.h"
+#include "memstats.h"
+#include "source.h"
+#include "split.h"
+#include "trace.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+typedef struct Options {
+	int quiet, stats, jobs, scaling, split, mem_report, intern, cache;
+	SymbolTable *symbols;
+	LexerBackend backend;
+} Options;
+
+typedef struct Totals {
+	long files, bytes, tokens;
+	double seconds;
+	ArenaStats memory;
+} Totals;
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static void usage(const char *name) {
+	fprintf(stderr,
+		"usage: %s [options] PATH...\n"
+		"\n"
+		"Lex each template and print its token stream. A directory stands for\n"
+		"every .manana file under it; - reads standard input.\n"
+		"\n"
+		"  -q, --quiet      don't print token streams\n"
+		"  -s, --stats      report per-file and total throughput on stderr\n"
+		"  -j, --jobs N     lex files on N threads (0: one per core); token\n"
+		"                   streams aren't printed in this mode\n"
+		"  -p, --split N    lex each file on N threads, split at lines that start\n"
+		"                   at column 0; only worth it for templates of several\n"
+		"                   MB with cores to spare, so smaller ones are lexed on\n"
+		"                   one thread and N is capped at the number of cores\n"
+		"      --mem-report report each file's arena allocations and peak\n"
+		"                   bytes on stderr, then what each subsystem allocated\n"
+		"                   and still holds once everything is freed\n"
+		"      --intern     intern tag names, classes, ids and attribute keys in\n"
+		"                   one table shared by every file, and print their\n"
+		"                   symbols as #N\n"
+		"      --cache      use PATH.tokens instead of lexing a template that\n"
+		"                   hasn't changed since it was saved there, and save\n"
+		"                   it there when it has\n"
+		"      --scaling    lex everything on 1, 2, 4 ... N threads and report\n"
+		"                   wall time and files/sec for each\n"
+		"      --lexer NAME lex with the hand-written lexer (hand, the default)\n"
+		"                   or the one generated from lexer.grammar (dfa)\n",
+		name);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static double mb_per_sec(long bytes, double seconds) {
+	return seconds > 0 ? bytes / seconds / (1024 * 1024) : 0;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static void print_memory(const char *name, ArenaStats *stats) {
+	fprintf(stderr, "%-40s %9zu allocs %6zu mallocs %10zu bytes used %10zu bytes peak\n",
+			name, stats->allocs, stats->mallocs, stats->used, stats->peak);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Sum of the counts, and the largest peak.
+static void add_memory(ArenaStats *total, ArenaStats *stats) {
+	total->allocs += stats->allocs;
+	total->mallocs += stats->mallocs;
+	total->used += stats->used;
+	if (stats->peak > total->peak)
+		total->peak = stats->peak;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static int lex_file(const char *path, Options *opts, Totals *totals) {
+	Source *source = Source_open(path);
+	if (source == NULL) {
+		fprintf(stderr, "%s: Can't load file: %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	Buffer *buf = Buffer_create(source->data, source->size);
+	if (buf == NULL) {
+		Source_close(source);
+		return -1;
+	}
+
+	buf->symbols = opts->symbols;
+	buf->backend = opts->backend;
+
+	// Standard input has nowhere to keep a cache.
+	char cache_path[PATH_MAX];
+	int use_cache = opts->cache && strcmp(path, "-") != 0 &&
+		TokenCache_path(path, cache_path, sizeof(cache_path)) == 0;
+
+	double start = now();
+	int count = use_cache ? TokenCache_load(buf, cache_path) : -1;
+	int cached = count >= 0;
+
+	if (!cached)
+		count = opts->split > 1 ? tokenize_split(buf, opts->split, 0) : tokenize(buf);
+	double elapsed = now() - start;
+
+	if (!cached && count >= 0 && use_cache)
+		TokenCache_save(buf, cache_path);
+
+	if (count < 0) {
+		fprintf(stderr, "%s:%d:%d: %s\n", path, buf->error_line, buf->error_column, buf->error_message);
+		Buffer_destroy(buf);
+		Source_close(source);
+		return -1;
+	}
+
+	if (!opts->quiet) {
+		printf("\n== %s\n", path);
+		Buffer_print_stream(buf);
+	}
+
+	if (opts->stats) {
+		fprintf(stderr, "%-40s %10ld bytes %9d tokens %9.3f ms %9.2f MB/s%s\n",
+				path, source->size, count, elapsed * 1000, mb_per_sec(source->size, elapsed),
+				cached ? " (cached)" : "");
+	}
+
+	if (opts->mem_report) {
+		ArenaStats memory;
+		Arena_stats(buf->arena, &memory);
+		print_memory(path, &memory);
+		add_memory(&totals->memory, &memory);
+	}
+
+	totals->files++;
+	totals->bytes += source->size;
+	totals->tokens += count;
+	totals->seconds += elapsed;
+
+	Buffer_destroy(buf);
+	Source_close(source);
+	return 0;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static void print_batch(Batch *batch, int threads, double base) {
+	fprintf(stderr, "%3d threads %10.3f ms %10.0f files/s %9.2f MB/s %6.2fx\n",
+			threads, batch->seconds * 1000,
+			batch->seconds > 0 ? batch->count / batch->seconds : 0,
+			mb_per_sec(batch->bytes, batch->seconds),
+			batch->seconds > 0 ? base / batch->seconds : 0);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Lex every path on a thread pool; errors are reported in path order
+// once all of them are done.
+static int lex_batch(Array *paths, Options *opts) {
+	int threads = opts->jobs > 0 ? opts->jobs : sysconf(_SC_NPROCESSORS_ONLN);
+	int failed;
+
+	Batch *batch = Batch_create(paths);
+	if (batch == NULL)
+		return -1;
+
+	batch->symbols = opts->symbols;
+	batch->cache = opts->cache;
+	batch->backend = opts->backend;
+
+	if (opts->scaling) {
+		double base = 0;
+		int n;
+
+		for (n = 1; ; n = n * 2 < threads ? n * 2 : threads) {
+			failed = Batch_run(batch, n, NULL, NULL);
+			if (n == 1)
+				base = batch->seconds;
+			print_batch(batch, n, base);
+			if (n == threads)
+				break;
+		}
+	} else {
+		failed = Batch_run(batch, threads, NULL, NULL);
+		if (opts->stats)
+			print_batch(batch, threads, batch->seconds);
+	}
+
+	Batch_print_errors(batch, stderr);
+
+	if (opts->mem_report) {
+		ArenaStats memory = { 0, 0, 0, 0, 0 };
+		int i;
+
+		for (i = 0; i < batch->count; i++) {
+			print_memory(batch->files[i].path, &batch->files[i].memory);
+			add_memory(&memory, &batch->files[i].memory);
+		}
+		print_memory("total", &memory);
+	}
+
+	if (opts->stats) {
+		fprintf(stderr, "%-40s %10ld bytes %9ld tokens %9.3f ms %9.2f MB/s (%d files)\n",
+				"total", batch->bytes, batch->tokens, batch->seconds * 1000,
+				mb_per_sec(batch->bytes, batch->seconds), batch->count);
+	}
+
+	Batch_destroy(batch);
+	return failed;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+int main(int argc, char *argv[]) {
+	Options opts = { 0, 0, -1, 0, 0, 0, 0, 0, NULL, LEXER_HAND };
+	Totals totals = { 0, 0, 0, 0, { 0, 0, 0, 0, 0 } };
+	int i, failed = 0;
+
+	Trace_init_from_env();
+
+	// Accounting has to see every allocation it will see freed, paths too.
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--mem-report") == 0)
+			MemStats_enable(1);
+	}
+
+	Array *paths = Array_create(0, 64);
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-q") == 0 || strcmp(argv[i], "--quiet") == 0) {
+			opts.quiet = 1;
+		} else if (strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "--stats") == 0) {
+			opts.stats = 1;
+		} else if ((strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--jobs") == 0) && i + 1 < argc) {
+			opts.jobs = atoi(argv[++i]);
+		} else if ((strcmp(argv[i], "-p") == 0 || strcmp(argv[i], "--split") == 0) && i + 1 < argc) {
+			opts.split = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--mem-report") == 0) {
+			opts.mem_report = 1;
+		} else if (strcmp(argv[i], "--intern") == 0) {
+			opts.intern = 1;
+		} else if (strcmp(argv[i], "--cache") == 0) {
+			opts.cache = 1;
+		} else if (strcmp(argv[i], "--scaling") == 0) {
+			opts.scaling = 1;
+		} else if (strcmp(argv[i], "--lexer") == 0 && i + 1 < argc) {
+			int backend = Lexer_backend_find(argv[++i]);
+			if (backend < 0) {
+				usage(argv[0]);
+				return 1;
+			}
+			opts.backend = backend;
+		} else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+			usage(argv[0]);
+			return 0;
+		} else if (strcmp(argv[i], "-") == 0) {
+			Array_push(paths, strdup("-"));
+		} else if (argv[i][0] == '-') {
+			usage(argv[0]);
+			return 1;
+		} else if (Source_find(argv[i], ".manana", paths) != 0) {
+			failed++;
+		}
+	}
+
+	if (Array_count(paths) == 0 && failed == 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	// Threads share the table, so it has to lock unless there's only one.
+	if (opts.intern) {
+		opts.symbols = SymbolTable_create(opts.jobs >= 0 || opts.scaling || opts.split > 1);
+		if (opts.symbols == NULL)
+			return 1;
+	}
+
+	if (opts.jobs >= 0 || opts.scaling) {
+		if (lex_batch(paths, &opts) != 0)
+			failed++;
+	} else {
+		for (i = 0; i < Array_count(paths); i++) {
+			if (lex_file(Array_get(paths, i), &opts, &totals) != 0)
+				failed++;
+		}
+	}
+
+	if (opts.stats && opts.jobs < 0 && !opts.scaling) {
+		fprintf(stderr, "%-40s %10ld bytes %9ld tokens %9.3f ms %9.2f MB/s (%ld files)\n",
+				"total", totals.bytes, totals.tokens, totals.seconds * 1000,
+				mb_per_sec(totals.bytes, totals.seconds), totals.files);
+	}
+
+	if (opts.mem_report && opts.jobs < 0 && !opts.scaling)
+		print_memory("total", &totals.memory);
+
+	if (opts.symbols) {
+		if (opts.stats)
+			fprintf(stderr, "%-40s %10d symbols\n", "interned", SymbolTable_count(opts.symbols));
+		SymbolTable_destroy(opts.symbols);
+	}
+
+	for (i = 0; i < Array_count(paths); i++)
+		free(Array_get(paths, i));
+	Array_destroy(paths);
+
+	// Anything still live here leaked.
+	if (opts.mem_report)
+		MemStats_print(stderr);
+
+	return failed ? 1 : 0;
+}
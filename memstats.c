@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "memstats.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+#define MEM_SUBSYSTEM_NAME(N, S) S,
+static const char *const mem_names[] = { MEM_SUBSYSTEMS(MEM_SUBSYSTEM_NAME) };
+#undef MEM_SUBSYSTEM_NAME
+
+typedef struct MemCounters {
+	_Atomic uint64_t allocs, frees, bytes;
+	_Atomic int64_t live, peak;
+} MemCounters;
+
+_Atomic int mem_accounting = 0;
+
+static MemCounters mem_counters[MEM_SUBSYSTEM_COUNT];
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Turn accounting on before the first allocation it should see: a free
+// of memory allocated while it was off would count as a leak in reverse.
+void MemStats_enable(int on) {
+	atomic_store(&mem_accounting, on);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static void MemStats_add_live(MemCounters *counters, int64_t delta) {
+	int64_t live = atomic_fetch_add_explicit(&counters->live, delta, memory_order_relaxed) + delta;
+	int64_t peak = atomic_load_explicit(&counters->peak, memory_order_relaxed);
+
+	while (live > peak && !atomic_compare_exchange_weak_explicit(&counters->peak, &peak, live,
+				memory_order_relaxed, memory_order_relaxed))
+		;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+void MemStats_alloc(MemSubsystem sub, size_t bytes) {
+	MemCounters *counters = &mem_counters[sub];
+
+	atomic_fetch_add_explicit(&counters->allocs, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&counters->bytes, bytes, memory_order_relaxed);
+	MemStats_add_live(counters, bytes);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// A resize counts as an allocation of whatever it added.
+void MemStats_realloc(MemSubsystem sub, size_t old_bytes, size_t bytes) {
+	MemCounters *counters = &mem_counters[sub];
+
+	atomic_fetch_add_explicit(&counters->allocs, 1, memory_order_relaxed);
+	if (bytes > old_bytes)
+		atomic_fetch_add_explicit(&counters->bytes, bytes - old_bytes, memory_order_relaxed);
+	MemStats_add_live(counters, (int64_t)bytes - (int64_t)old_bytes);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+void MemStats_free(MemSubsystem sub, size_t bytes) {
+	MemCounters *counters = &mem_counters[sub];
+
+	atomic_fetch_add_explicit(&counters->frees, 1, memory_order_relaxed);
+	MemStats_add_live(counters, -(int64_t)bytes);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+void MemStats_get(MemSubsystem sub, MemStats *stats) {
+	MemCounters *counters = &mem_counters[sub];
+
+	stats->allocs = atomic_load(&counters->allocs);
+	stats->frees = atomic_load(&counters->frees);
+	stats->bytes = atomic_load(&counters->bytes);
+	stats->live = atomic_load(&counters->live);
+	stats->peak = atomic_load(&counters->peak);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+const char *MemStats_name(MemSubsystem sub) {
+	return sub < MEM_SUBSYSTEM_COUNT ? mem_names[sub] : "?";
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// One line per subsystem; "live" is what it still holds.
+void MemStats_print(FILE *out) {
+	MemStats stats;
+	int i;
+
+	for (i = 0; i < MEM_SUBSYSTEM_COUNT; i++) {
+		MemStats_get(i, &stats);
+		fprintf(out, "%-40s %9llu allocs %9llu frees %12llu bytes %10lld bytes live %10lld bytes peak\n",
+				MemStats_name(i), (unsigned long long)stats.allocs, (unsigned long long)stats.frees,
+				(unsigned long long)stats.bytes, (long long)stats.live, (long long)stats.peak);
+	}
+}
@@ -0,0 +1,72 @@
+#ifndef _MANANA_MEMSTATS_H
+#define _MANANA_MEMSTATS_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Allocation accounting: what each subsystem allocates, off unless
+// MemStats_enable turns it on (main does for --mem-report). Allocations
+// are rare enough, a chunk or a resize at a time, that checking the flag
+// costs nothing measurable, so it isn't compiled out like tracing.
+//
+// Each subsystem counts its allocations (reallocs included), the bytes
+// they added, the bytes it holds now and the most it ever held, across
+// every thread. Memory a subsystem takes from an Arena is in the arena's
+// numbers as well, and is held until the arena is reset or destroyed:
+// see Arena_account. Whatever is still held once everything has been
+// destroyed has leaked.
+#define MEM_SUBSYSTEMS(X)\
+	X(ARENA,   "arena")\
+	X(SDS,     "sds")\
+	X(ARRAY,   "array")\
+	X(INDENT,  "indent")\
+	X(TOKENS,  "tokens")\
+	X(LINES,   "lines")\
+	X(SYMBOLS, "symbols")
+
+#define MEM_SUBSYSTEM_ENUM(N, S) MEM_##N,
+typedef enum { MEM_SUBSYSTEMS(MEM_SUBSYSTEM_ENUM) MEM_SUBSYSTEM_COUNT } MemSubsystem;
+#undef MEM_SUBSYSTEM_ENUM
+
+typedef struct MemStats {
+	uint64_t allocs, frees, bytes;
+	int64_t live, peak;
+} MemStats;
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+extern _Atomic int mem_accounting;
+
+void MemStats_enable(int on);
+void MemStats_alloc(MemSubsystem sub, size_t bytes);
+void MemStats_realloc(MemSubsystem sub, size_t old_bytes, size_t bytes);
+void MemStats_free(MemSubsystem sub, size_t bytes);
+void MemStats_get(MemSubsystem sub, MemStats *stats);
+const char *MemStats_name(MemSubsystem sub);
+void MemStats_print(FILE *out);
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+#define mem_accounting_enabled() atomic_load_explicit(&mem_accounting, memory_order_relaxed)
+
+#define mem_alloc(SUB, BYTES)\
+	do {\
+		if (mem_accounting_enabled())\
+			MemStats_alloc((SUB), (BYTES));\
+	} while (0)
+
+#define mem_realloc(SUB, OLD, BYTES)\
+	do {\
+		if (mem_accounting_enabled())\
+			MemStats_realloc((SUB), (OLD), (BYTES));\
+	} while (0)
+
+#define mem_free(SUB, BYTES)\
+	do {\
+		if (mem_accounting_enabled())\
+			MemStats_free((SUB), (BYTES));\
+	} while (0)
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+#endif
@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "debug.h"
+#include "relex.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Whether old's resync points can be trusted to number the tokens in its
+// stream: it lexed all of its source, into the stream.
+static int relex_usable(Buffer *old) {
+	return !old->error && old->pos >= old->limit && old->resync_count > 0
+		&& TokenStream_count(old->stream) == old->emitted;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// The last of old's resync points far enough before offset for nothing at
+// offset to have been seen by the lexer yet, or -1.
+static int relex_before(Buffer *old, long offset) {
+	int lo = 0, hi = old->resync_count;
+
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (old->resync[mid].offset + RELEX_LOOKAHEAD <= offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo - 1;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// The first of old's resync points at or after offset, or resync_count.
+static int relex_after(Buffer *old, long offset) {
+	int lo = 0, hi = old->resync_count;
+
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (old->resync[mid].offset < offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Lex src, old's source after edit, as far as the edit changed it. Returns
+// the number of tokens relexed, or -1 on error; if the new source doesn't
+// lex, its error is in splice->buf. Either way splice is released with
+// TokenSplice_release.
+int relex(Buffer *old, char *src, long src_size, SourceEdit edit, TokenSplice *splice) {
+	long shift = edit.new_end - edit.old_end;
+	int usable = relex_usable(old);
+	int r, converged = 0;
+
+	memset(splice, 0, sizeof(TokenSplice));
+	splice->shift = shift;
+
+	check(edit.start >= 0 && edit.start <= edit.old_end && edit.old_end <= old->src_size
+			&& edit.new_end >= edit.start && src_size - old->src_size == shift,
+			"Edit [%ld, %ld) -> [%ld, %ld) doesn't fit the sources.",
+			edit.start, edit.old_end, edit.start, edit.new_end);
+
+	Buffer *buf = Buffer_create(src, src_size);
+	check_mem(buf);
+
+	splice->buf = buf;
+	buf->symbols = old->symbols;
+	buf->backend = old->backend;
+	buf->track_resync = 1;
+
+	if (usable && (r = relex_before(old, edit.start)) >= 0) {
+		ResyncPoint *from = &old->resync[r];
+
+		Buffer_jump(buf, from->offset);
+		buf->emitted = from->index;
+		buf->initial_indent = old->initial_indent;
+
+		splice->first = from->index;
+		splice->start = from->offset;
+	}
+
+	// Lex up to each old resync point after the edit in turn, until the new
+	// lexer stops at one in the initial state too. lex_eof dedents to the
+	// file's initial indentation, so that has to be the same as well.
+	int to = usable ? relex_after(old, edit.old_end) : old->resync_count;
+
+	for (; to < old->resync_count; to++) {
+		ResyncPoint *point = &old->resync[to];
+
+		buf->limit = point->offset + shift;
+		if (tokenize(buf) < 0)
+			break;
+
+		if (buf->pos == buf->limit && Buffer_at_resync(buf) && buf->initial_indent == old->initial_indent) {
+			splice->removed = point->index - splice->first;
+			splice->end = buf->pos;
+			converged = 1;
+			break;
+		}
+	}
+
+	if (!converged && !buf->error) {
+		buf->limit = src_size + 1;
+		tokenize(buf);
+
+		splice->removed = TokenStream_count(old->stream) - splice->first;
+		splice->end = src_size;
+	}
+
+	splice->added = TokenStream_count(buf->stream);
+	return buf->error ? -1 : splice->added;
+error:
+	return -1;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// A Buffer for the new source holding its whole token stream, with the
+// resync points to relex it again. old and splice are left as they were.
+// Returns NULL if splice didn't lex or there's no memory.
+Buffer *TokenSplice_apply(Buffer *old, TokenSplice *splice) {
+	Buffer *fresh = splice->buf, *buf = NULL;
+	int rest = splice->first + splice->removed;
+	int moved = splice->added - splice->removed;
+	int i, rc = 0;
+
+	check(fresh && !fresh->error, "Can't apply a splice that didn't lex.");
+
+	buf = Buffer_create(fresh->src, fresh->src_size);
+	check_mem(buf);
+
+	buf->symbols = fresh->symbols;
+	buf->backend = fresh->backend;
+	buf->track_resync = 1;
+
+	rc |= TokenStream_append(buf->stream, old->stream, 0, splice->first, 0);
+	rc |= TokenStream_append(buf->stream, fresh->stream, 0, splice->added, 0);
+	rc |= TokenStream_append(buf->stream, old->stream, rest, TokenStream_count(old->stream) - rest, splice->shift);
+
+	// The relexed resync points are numbered in the new stream already.
+	for (i = 0; i < old->resync_count && old->resync[i].offset < splice->start; i++)
+		rc |= Buffer_push_resync(buf, old->resync[i].offset, old->resync[i].index);
+	for (i = 0; i < fresh->resync_count; i++)
+		rc |= Buffer_push_resync(buf, fresh->resync[i].offset, fresh->resync[i].index);
+	for (i = relex_after(old, splice->end - splice->shift); splice->end < fresh->src_size && i < old->resync_count; i++)
+		rc |= Buffer_push_resync(buf, old->resync[i].offset + splice->shift, old->resync[i].index + moved);
+
+	check(rc == 0, "Out of memory.");
+
+	// Done lexing, as if it had lexed all of it.
+	buf->pos = buf->limit;
+	buf->emitted = TokenStream_count(buf->stream);
+	buf->initial_indent = fresh->initial_indent;
+
+	return buf;
+error:
+	if (buf)
+		Buffer_destroy(buf);
+	return NULL;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+void TokenSplice_release(TokenSplice *splice) {
+	if (splice->buf)
+		Buffer_destroy(splice->buf);
+	splice->buf = NULL;
+}
@@ -0,0 +1,51 @@
+#ifndef _MANANA_RELEX_H
+#define _MANANA_RELEX_H
+
+#include "lexer.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Lex a template again after an edit, only as far as the edit can have
+// changed its tokens.
+//
+// The old Buffer must have been lexed by tokenize with track_resync set,
+// so it knows its resync points (see ResyncPoint): lines at column 0,
+// outside any """ comment, string or :filter block, where the lexer is in
+// the state it starts a file in. The new source is lexed from the last
+// of them before the edit, by a lexer started in that state. It stops at
+// the first of the old resync points after the edit that it also reaches
+// in that state, since from there on both lexers see the same text in the
+// same state: the rest of the old tokens only move by the size of the
+// edit. Without resync points the new source is lexed from the top, and
+// without any to stop at, to the end.
+//
+// The result is a splice: the relexed tokens, which replace removed old
+// tokens starting at first, and shift, by which the old tokens after them
+// move. They were lexed from src[start, end) of the new source, which is
+// src[start, end - shift) of the old one. TokenSplice_apply builds the
+// whole new stream from it.
+//
+// A step ending at a line start has already looked one character into
+// the line, so resync points that close to the edit aren't trusted.
+#define RELEX_LOOKAHEAD 2
+
+// src[start, old_end) of the old source became src[start, new_end) of the
+// new one.
+typedef struct SourceEdit {
+	long start, old_end, new_end;
+} SourceEdit;
+
+// buf holds the relexed tokens, and is the Buffer for the new source: its
+// errors are the new source's errors, at lines and columns in it.
+typedef struct TokenSplice {
+	Buffer *buf;
+	int first, removed, added;
+	long start, end, shift;
+} TokenSplice;
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+int relex(Buffer *old, char *src, long src_size, SourceEdit edit, TokenSplice *splice);
+Buffer *TokenSplice_apply(Buffer *old, TokenSplice *splice);
+void TokenSplice_release(TokenSplice *splice);
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+#endif
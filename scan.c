@@ -0,0 +1,215 @@
+#include <stdint.h>
+#include "scan.h"
+
+#ifdef MANANA_SCAN_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+#define is_text_end(S, I, END)\
+	((S)[I] == '\n' || (S)[I] == '\0' || ((S)[I] == '@' && (I) + 1 < (END) && (S)[(I)+1] == '{'))
+
+#define is_comment_end(S, I, END)\
+	((S)[I] == '\0' || ((S)[I] == '"' && (I) + 2 < (END) && (S)[(I)+1] == '"' && (S)[(I)+2] == '"'))
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+size_t scan_text_scalar(const char *src, size_t pos, size_t end) {
+	while (pos < end && !is_text_end(src, pos, end))
+		pos++;
+	return pos;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+size_t scan_comment_scalar(const char *src, size_t pos, size_t end) {
+	while (pos < end && !is_comment_end(src, pos, end))
+		pos++;
+	return pos;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+size_t scan_lines_scalar(const char *src, size_t pos, size_t end, uint32_t *starts) {
+	size_t count = 0;
+
+	for (; pos < end; pos++) {
+		if (src[pos] == '\n') {
+			if (starts)
+				starts[count] = pos + 1;
+			count++;
+		}
+	}
+
+	return count;
+}
+
+#ifdef MANANA_SCAN_X86
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// The vector loops test 16 (or 32) bytes per step for any candidate byte;
+// an "@" is only a delimiter when "{" follows, which is checked per hit.
+// Comments compare three shifted loads so that a bit is set only where
+// all three quotes start. The scalar loop finishes the last partial block.
+size_t scan_text_sse2(const char *src, size_t pos, size_t end) {
+	const __m128i nl = _mm_set1_epi8('\n');
+	const __m128i nul = _mm_setzero_si128();
+	const __m128i at = _mm_set1_epi8('@');
+
+	// +1 so the "{" after an "@" in the last lane can be read too.
+	while (pos + 16 + 1 <= end) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(src + pos));
+		__m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, nl), _mm_cmpeq_epi8(v, nul)),
+				_mm_cmpeq_epi8(v, at));
+		unsigned mask = _mm_movemask_epi8(hit);
+
+		while (mask) {
+			unsigned i = __builtin_ctz(mask);
+			if (src[pos+i] != '@' || src[pos+i+1] == '{')
+				return pos + i;
+			mask &= mask - 1;
+		}
+		pos += 16;
+	}
+
+	return scan_text_scalar(src, pos, end);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+__attribute__((target("avx2")))
+size_t scan_text_avx2(const char *src, size_t pos, size_t end) {
+	const __m256i nl = _mm256_set1_epi8('\n');
+	const __m256i nul = _mm256_setzero_si256();
+	const __m256i at = _mm256_set1_epi8('@');
+
+	while (pos + 32 + 1 <= end) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(src + pos));
+		__m256i hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, nl), _mm256_cmpeq_epi8(v, nul)),
+				_mm256_cmpeq_epi8(v, at));
+		unsigned mask = _mm256_movemask_epi8(hit);
+
+		while (mask) {
+			unsigned i = __builtin_ctz(mask);
+			if (src[pos+i] != '@' || src[pos+i+1] == '{')
+				return pos + i;
+			mask &= mask - 1;
+		}
+		pos += 32;
+	}
+
+	return scan_text_sse2(src, pos, end);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+size_t scan_comment_sse2(const char *src, size_t pos, size_t end) {
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i nul = _mm_setzero_si128();
+
+	while (pos + 16 + 2 <= end) {
+		__m128i v0 = _mm_loadu_si128((const __m128i *)(src + pos));
+		__m128i v1 = _mm_loadu_si128((const __m128i *)(src + pos + 1));
+		__m128i v2 = _mm_loadu_si128((const __m128i *)(src + pos + 2));
+		__m128i quotes = _mm_and_si128(_mm_cmpeq_epi8(v0, quote),
+				_mm_and_si128(_mm_cmpeq_epi8(v1, quote), _mm_cmpeq_epi8(v2, quote)));
+		unsigned mask = _mm_movemask_epi8(_mm_or_si128(quotes, _mm_cmpeq_epi8(v0, nul)));
+
+		if (mask)
+			return pos + __builtin_ctz(mask);
+		pos += 16;
+	}
+
+	return scan_comment_scalar(src, pos, end);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+__attribute__((target("avx2")))
+size_t scan_comment_avx2(const char *src, size_t pos, size_t end) {
+	const __m256i quote = _mm256_set1_epi8('"');
+	const __m256i nul = _mm256_setzero_si256();
+
+	while (pos + 32 + 2 <= end) {
+		__m256i v0 = _mm256_loadu_si256((const __m256i *)(src + pos));
+		__m256i v1 = _mm256_loadu_si256((const __m256i *)(src + pos + 1));
+		__m256i v2 = _mm256_loadu_si256((const __m256i *)(src + pos + 2));
+		__m256i quotes = _mm256_and_si256(_mm256_cmpeq_epi8(v0, quote),
+				_mm256_and_si256(_mm256_cmpeq_epi8(v1, quote), _mm256_cmpeq_epi8(v2, quote)));
+		unsigned mask = _mm256_movemask_epi8(_mm256_or_si256(quotes, _mm256_cmpeq_epi8(v0, nul)));
+
+		if (mask)
+			return pos + __builtin_ctz(mask);
+		pos += 32;
+	}
+
+	return scan_comment_sse2(src, pos, end);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Newlines are only counted when there's nowhere to put them, which is
+// one popcount per block.
+size_t scan_lines_sse2(const char *src, size_t pos, size_t end, uint32_t *starts) {
+	const __m128i nl = _mm_set1_epi8('\n');
+	size_t count = 0;
+
+	while (pos + 16 <= end) {
+		unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(src + pos)), nl));
+
+		if (starts == NULL) {
+			count += __builtin_popcount(mask);
+		} else {
+			for (; mask; mask &= mask - 1)
+				starts[count++] = pos + __builtin_ctz(mask) + 1;
+		}
+		pos += 16;
+	}
+
+	return count + scan_lines_scalar(src, pos, end, starts ? starts + count : NULL);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+__attribute__((target("avx2")))
+size_t scan_lines_avx2(const char *src, size_t pos, size_t end, uint32_t *starts) {
+	const __m256i nl = _mm256_set1_epi8('\n');
+	size_t count = 0;
+
+	while (pos + 32 <= end) {
+		unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(src + pos)), nl));
+
+		if (starts == NULL) {
+			count += __builtin_popcount(mask);
+		} else {
+			for (; mask; mask &= mask - 1)
+				starts[count++] = pos + __builtin_ctz(mask) + 1;
+		}
+		pos += 32;
+	}
+
+	return count + scan_lines_sse2(src, pos, end, starts ? starts + count : NULL);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+Scanner scan_text = scan_text_sse2;
+Scanner scan_comment = scan_comment_sse2;
+LineScanner scan_lines = scan_lines_sse2;
+
+__attribute__((constructor))
+static void scan_init() {
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		scan_text = scan_text_avx2;
+		scan_comment = scan_comment_avx2;
+		scan_lines = scan_lines_avx2;
+	}
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+const char *scan_variant() {
+	return scan_text == scan_text_avx2 ? "avx2" : "sse2";
+}
+
+#else
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+Scanner scan_text = scan_text_scalar;
+Scanner scan_comment = scan_comment_scalar;
+LineScanner scan_lines = scan_lines_scalar;
+
+const char *scan_variant() {
+	return "scalar";
+}
+#endif
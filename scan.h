@@ -0,0 +1,44 @@
+#ifndef _MANANA_SCAN_H
+#define _MANANA_SCAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Scanners for the long runs the lexer skips over: text up to the next
+// "@{", newline or NUL, and comments up to the closing """. Each returns
+// the position of the delimiter, searching src[pos, end). If there is no
+// delimiter before end, end is returned.
+//
+// The SSE2/AVX2 variants never read at or past end, so end may be the
+// size of the allocation. scan_text/scan_comment pick the widest variant
+// the CPU supports once at startup.
+typedef size_t (*Scanner)(const char *src, size_t pos, size_t end);
+
+// scan_lines finds every newline in src[pos, end) instead: it writes the
+// position after each one to starts, unless starts is NULL, and returns
+// how many there were.
+typedef size_t (*LineScanner)(const char *src, size_t pos, size_t end, uint32_t *starts);
+
+extern Scanner scan_text;
+extern Scanner scan_comment;
+extern LineScanner scan_lines;
+
+size_t scan_text_scalar(const char *src, size_t pos, size_t end);
+size_t scan_comment_scalar(const char *src, size_t pos, size_t end);
+size_t scan_lines_scalar(const char *src, size_t pos, size_t end, uint32_t *starts);
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MANANA_SCAN_X86 1
+size_t scan_text_sse2(const char *src, size_t pos, size_t end);
+size_t scan_text_avx2(const char *src, size_t pos, size_t end);
+size_t scan_comment_sse2(const char *src, size_t pos, size_t end);
+size_t scan_comment_avx2(const char *src, size_t pos, size_t end);
+size_t scan_lines_sse2(const char *src, size_t pos, size_t end, uint32_t *starts);
+size_t scan_lines_avx2(const char *src, size_t pos, size_t end, uint32_t *starts);
+#endif
+
+const char *scan_variant();
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+#endif
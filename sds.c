@@ -35,6 +35,7 @@
 #include <assert.h>
 
 #include "sds.h"
+#include "memstats.h"
 
 /* Create a new sds string with the content specified by the 'init' pointer
  * and 'initlen'.
@@ -57,6 +58,7 @@ sds sdsnewlen(const void *init, size_t initlen) {
         sh = calloc(sizeof *sh+initlen+1,1);
     }
     if (sh == NULL) return NULL;
+    mem_alloc(MEM_SDS, sizeof *sh+initlen+1);
     sh->len = initlen;
     sh->free = 0;
     if (initlen && init)
@@ -85,6 +87,7 @@ sds sdsdup(const sds s) {
 /* Free an sds string. No operation is performed if 's' is NULL. */
 void sdsfree(sds s) {
     if (s == NULL) return;
+    mem_free(MEM_SDS, sdsAllocSize(s));
     free(s-sizeof(struct sdshdr));
 }
 
@@ -141,6 +144,7 @@ sds sdsMakeRoomFor(sds s, size_t addlen) {
         newlen += SDS_MAX_PREALLOC;
     newsh = realloc(sh, sizeof *newsh+newlen+1);
     if (newsh == NULL) return NULL;
+    mem_realloc(MEM_SDS, sizeof *newsh+len+free+1, sizeof *newsh+newlen+1);
 
     newsh->free = newlen - len;
     return newsh->buf;
@@ -156,6 +160,7 @@ sds sdsRemoveFreeSpace(sds s) {
     struct sdshdr *sh;
 
     sh = (void*) (s-sizeof *sh);;
+    mem_realloc(MEM_SDS, sdsAllocSize(s), sizeof *sh+sh->len+1);
     sh = realloc(sh, sizeof *sh+sh->len+1);
     sh->free = 0;
     return sh->buf;
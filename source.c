@@ -0,0 +1,187 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "debug.h"
+#include "source.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static int Source_map(Source *source, int fd, size_t size) {
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t length = (size + SOURCE_PADDING + page - 1) / page * page;
+
+	// Reserve zero pages for the file plus padding, then map the file over
+	// the front. The rest of the file's last page is zero-filled as well.
+	char *region = mmap(NULL, length, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (region == MAP_FAILED)
+		return -1;
+
+	char *data = mmap(region, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0);
+	if (data == MAP_FAILED) {
+		munmap(region, length);
+		return -1;
+	}
+
+	madvise(data, size, MADV_SEQUENTIAL);
+
+	source->data = data;
+	source->mapped = length;
+	return 0;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static int Source_read(Source *source, int fd) {
+	size_t max = 64 * 1024, size = 0;
+	char *data = malloc(max + SOURCE_PADDING);
+	if (data == NULL)
+		return -1;
+
+	for (;;) {
+		ssize_t n = read(fd, data + size, max - size);
+		if (n < 0)
+			goto error;
+		if (n == 0)
+			break;
+
+		size += n;
+		if (size == max) {
+			max *= 2;
+			char *grown = realloc(data, max + SOURCE_PADDING);
+			if (grown == NULL)
+				goto error;
+			data = grown;
+		}
+	}
+
+	memset(data + size, 0, SOURCE_PADDING);
+
+	source->data = data;
+	source->size = size;
+	source->mapped = 0;
+	return 0;
+error:
+	free(data);
+	return -1;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Returns NULL with errno set if path can't be loaded. Nothing is printed:
+// this runs on batch workers, and the caller reports it (see batch.h).
+Source *Source_open(const char *path) {
+	int fd = -1, saved;
+	Source *source = calloc(1, sizeof(Source));
+	if (source == NULL)
+		return NULL;
+
+	source->path = strdup(path);
+	if (source->path == NULL)
+		goto error;
+
+	if (strcmp(path, "-") == 0) {
+		fd = STDIN_FILENO;
+	} else if ((fd = open(path, O_RDONLY)) < 0) {
+		goto error;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+		goto error;
+
+	// Empty files can't be mapped; they take the read path like pipes do.
+	if (S_ISREG(st.st_mode) && st.st_size > 0 && Source_map(source, fd, st.st_size) == 0) {
+		source->size = st.st_size;
+	} else if (Source_read(source, fd) != 0) {
+		goto error;
+	}
+
+	if (fd != STDIN_FILENO)
+		close(fd);
+
+	return source;
+error:
+	saved = errno;
+	if (fd >= 0 && fd != STDIN_FILENO)
+		close(fd);
+	Source_close(source);
+	errno = saved;
+	return NULL;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+void Source_close(Source *source) {
+	if (source == NULL)
+		return;
+
+	if (source->mapped)
+		munmap(source->data, source->mapped);
+	else
+		free(source->data);
+
+	free(source->path);
+	free(source);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static int ends_with(const char *str, const char *ext) {
+	size_t len = strlen(str), ext_len = strlen(ext);
+	return len >= ext_len && strcmp(str + len - ext_len, ext) == 0;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static int compare_paths(const void *a, const void *b) {
+	return strcmp(*(char **)a, *(char **)b);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Add path to paths if it's a file, or every file under it ending in ext
+// if it's a directory. Paths are strdup'd.
+int Source_find(const char *path, const char *ext, Array *paths) {
+	struct stat st;
+	DIR *dir = NULL;
+
+	check(stat(path, &st) == 0, "Can't stat %s", path);
+
+	if (!S_ISDIR(st.st_mode)) {
+		Array_push(paths, strdup(path));
+		return 0;
+	}
+
+	dir = opendir(path);
+	check(dir, "Can't open directory %s", path);
+
+	int first = Array_count(paths);
+
+	struct dirent *entry;
+	while ((entry = readdir(dir))) {
+		if (entry->d_name[0] == '.')
+			continue;
+
+		size_t len = strlen(path) + strlen(entry->d_name) + 2;
+		char *child = malloc(len);
+		check_mem(child);
+		snprintf(child, len, "%s/%s", path, entry->d_name);
+
+		if (stat(child, &st) == 0) {
+			if (S_ISDIR(st.st_mode))
+				Source_find(child, ext, paths);
+			else if (ends_with(child, ext))
+				Array_push(paths, strdup(child));
+		}
+		free(child);
+	}
+
+	closedir(dir);
+
+	// readdir order is arbitrary; keep runs reproducible.
+	qsort(paths->contents + first, Array_count(paths) - first, sizeof(void *), compare_paths);
+
+	return 0;
+error:
+	if (dir)
+		closedir(dir);
+	return -1;
+}
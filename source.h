@@ -0,0 +1,31 @@
+#ifndef _MANANA_SOURCE_H
+#define _MANANA_SOURCE_H
+
+#include <stddef.h>
+#include "array.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// A template loaded for lexing. Regular files are mapped read-only; pipes
+// and stdin ("-") are read into memory instead.
+//
+// Either way data is followed by at least SOURCE_PADDING zero bytes, so
+// the lexer's NUL-terminated look-ahead (src[pos+1], src[pos+2]) and the
+// SIMD scanners can read past the last byte of the file without faulting.
+// A mapping gets its padding by reserving an anonymous zero-filled region
+// one page larger than the file and mapping the file over the front of it.
+#define SOURCE_PADDING 64
+
+typedef struct Source {
+	char *path;
+	char *data;
+	long size;
+	size_t mapped;
+} Source;
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+Source *Source_open(const char *path);
+void Source_close(Source *source);
+int Source_find(const char *path, const char *ext, Array *paths);
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+#endif
@@ -0,0 +1,230 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include "debug.h"
+#include "split.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+typedef struct SplitChunk {
+	Buffer *buf;
+	long start, end;
+} SplitChunk;
+
+typedef struct Split {
+	Buffer *buf;
+	SplitChunk *chunks;
+	int count;
+	_Atomic int next;
+} Split;
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// The first line at or after from that starts at column 0 with something
+// other than whitespace, or size if there is none.
+static long split_boundary(const char *src, long from, long size) {
+	const char *p = src + from, *end = src + size;
+
+	while (p < end && (p = memchr(p, '\n', end - p)) != NULL) {
+		p++;
+		if (p < end && *p != '\n' && !is_class(*p, CC_SPACE))
+			return p - src;
+	}
+
+	return size;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Lex a chunk from the initial state. Every chunk stops short of EOF;
+// lex_eof runs once, on whichever Buffer ends up lexing the last chunk.
+// Names are interned as they're lexed only if the table can take it;
+// otherwise split_append interns them on the stitching thread.
+static void split_lex(Split *split, SplitChunk *chunk) {
+	SymbolTable *symbols = split->buf->symbols;
+
+	Buffer *buf = Buffer_create(split->buf->src, split->buf->src_size);
+	if (buf == NULL)
+		return;
+
+	if (symbols && symbols->concurrent)
+		buf->symbols = symbols;
+	buf->backend = split->buf->backend;
+
+	Buffer_jump(buf, chunk->start);
+	buf->limit = chunk->end;
+	tokenize(buf);
+
+	chunk->buf = buf;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static void *split_run(void *arg) {
+	Split *split = arg;
+	int i;
+
+	while ((i = atomic_fetch_add(&split->next, 1)) < split->count)
+		split_lex(split, &split->chunks[i]);
+
+	return NULL;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Whether buf stopped at boundary in the state a chunk is lexed from.
+static int split_clean(Buffer *buf, long boundary) {
+	return !buf->error && buf->pos == boundary && buf->filter_indent < 0
+		&& buf->indent_stack.length == 1;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Copy from's tokens onto the end of buf's stream, lazy ones still lazy.
+// Implied values are literals, so they can be shared.
+static int split_append(Buffer *buf, Buffer *from) {
+	TokenIter it = TokenStream_iter_raw(from->stream);
+	Token tok;
+
+	while (TokenIter_next(&it, &tok)) {
+		if (buf->symbols && tok.symbol == SYM_NONE && Token_has_symbol(tok.type)) {
+			if ((tok.symbol = Buffer_intern(buf, &tok)) == SYM_NONE)
+				return -1;
+		}
+
+		if (TokenStream_push(buf->stream, &tok) != 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Lex buf on up to threads threads in chunks of about chunk_size bytes.
+// Same results as tokenize, which it falls back to for a single chunk or
+// thread. With chunk_size 0 the chunks are SPLIT_CHUNK_SIZE and the split
+// is only made where it can pay off (see split.h); a chunk size given
+// explicitly always splits, so the stitching can be tested on any machine.
+int tokenize_split(Buffer *buf, int threads, long chunk_size) {
+	Split split = { buf, NULL, 0, 0 };
+	pthread_t *workers = NULL;
+	Buffer *cur = NULL;
+	int i, started = 0, rc = -1;
+
+	if (threads <= 1 || buf->pos > 0)
+		return tokenize(buf);
+
+	// More threads than cores would only take turns.
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cores >= 1 && threads > cores)
+		threads = cores;
+
+	if (chunk_size <= 0) {
+		if (threads <= 1 || buf->src_size < SPLIT_MIN_SIZE)
+			return tokenize(buf);
+		chunk_size = SPLIT_CHUNK_SIZE;
+	}
+
+	if (buf->src_size <= chunk_size)
+		return tokenize(buf);
+
+	// A NUL byte runs lex_eof in the middle of the source, which depends on
+	// more state than a chunk boundary checks for.
+	if (memchr(buf->src, '\0', buf->src_size) != NULL)
+		return tokenize(buf);
+
+	split.chunks = calloc(buf->src_size / chunk_size + 1, sizeof(SplitChunk));
+	check_mem(split.chunks);
+
+	long start = 0;
+	while (start < buf->src_size) {
+		long end = start + chunk_size >= buf->src_size
+			? buf->src_size
+			: split_boundary(buf->src, start + chunk_size, buf->src_size);
+
+		split.chunks[split.count].start = start;
+		split.chunks[split.count].end = end;
+		split.count++;
+		start = end;
+	}
+
+	if (threads > split.count)
+		threads = split.count;
+
+	// This thread lexes chunks too.
+	workers = calloc(threads, sizeof(pthread_t));
+	check_mem(workers);
+
+	for (started = 0; started < threads - 1; started++) {
+		if (pthread_create(&workers[started], NULL, split_run, &split) != 0)
+			break;
+	}
+	split_run(&split);
+
+	for (i = 0; i < started; i++)
+		pthread_join(workers[i], NULL);
+
+	for (i = 0; i < split.count; i++)
+		check_mem(split.chunks[i].buf);
+
+	// Stitch. cur is the Buffer that lexed up to chunk k. Lines come from
+	// offsets into the one source, so they need no adjusting.
+	cur = split.chunks[0].buf;
+	int initial_indent = -1;
+	split.chunks[0].buf = NULL;
+
+	for (i = 1; i < split.count && !cur->error; i++) {
+		SplitChunk *chunk = &split.chunks[i];
+
+		if (split_clean(cur, chunk->start)) {
+			if (initial_indent < 0 && cur->emitted)
+				initial_indent = cur->initial_indent;
+
+			check(split_append(buf, cur) == 0, "Failed to stitch token streams.");
+			Buffer_destroy(cur);
+
+			cur = chunk->buf;
+			chunk->buf = NULL;
+		} else {
+			// Wrong guess; carry on from where cur stopped instead.
+			Buffer_destroy(chunk->buf);
+			chunk->buf = NULL;
+
+			cur->limit = chunk->end;
+			tokenize(cur);
+		}
+	}
+
+	// lex_eof dedents to the indentation of the first token in the file,
+	// which may have been in an earlier chunk.
+	if (initial_indent >= 0)
+		cur->initial_indent = initial_indent;
+
+	cur->limit = buf->src_size + 1;
+	tokenize(cur);
+
+	check(split_append(buf, cur) == 0, "Failed to stitch token streams.");
+
+	buf->pos = cur->pos;
+
+	if (cur->error) {
+		buf->error = 1;
+		buf->error_line = cur->error_line;
+		buf->error_column = cur->error_column;
+		buf->error_pos = cur->error_pos;
+		memcpy(buf->error_message, cur->error_message, sizeof(buf->error_message));
+	}
+
+	rc = buf->error ? -1 : TokenStream_count(buf->stream);
+
+error:
+	if (cur)
+		Buffer_destroy(cur);
+	if (split.chunks) {
+		for (i = 0; i < split.count; i++) {
+			if (split.chunks[i].buf)
+				Buffer_destroy(split.chunks[i].buf);
+		}
+	}
+	free(split.chunks);
+	free(workers);
+
+	return rc < 0 && !buf->error ? Buffer_fail(buf, "Out of memory.") : rc;
+}
@@ -0,0 +1,34 @@
+#ifndef _MANANA_SPLIT_H
+#define _MANANA_SPLIT_H
+
+#include "lexer.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Lex one large template on several threads.
+//
+// A line that starts at column 0 is where the lexer is usually back in its
+// initial state: indent stack [0], no :filter block open. The source is cut
+// into chunks at such lines and every chunk is lexed on its own, as if
+// that were true. The guess is checked when the chunks are stitched back
+// together: if the lexer of the chunk before didn't stop exactly at the cut
+// in that state (a """ comment or string ran across it, a :filter block
+// ended on it, ...), the chunk is thrown away and lexed again where the
+// chunk before left off. The stitched stream is always the one tokenize
+// would have produced.
+//
+// Lexing chunks on guesses and checking them costs more than it saves
+// unless the chunks really run at the same time, and the cost of a thread
+// is paid however little it lexes. So no more threads are used than there
+// are cores, and with the default chunk size a source smaller than
+// SPLIT_MIN_SIZE, or any source on one core, is just tokenized. On one core
+// splitbench measures a split at 0.2x to 0.8x of tokenize. An explicit
+// chunk size always splits, on the calling thread alone if need be, so the
+// stitching can be tested anywhere.
+#define SPLIT_CHUNK_SIZE (1024 * 1024)
+#define SPLIT_MIN_SIZE (4 * SPLIT_CHUNK_SIZE)
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+int tokenize_split(Buffer *buf, int threads, long chunk_size);
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+#endif
@@ -0,0 +1,237 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "debug.h"
+#include "stream.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Tokens are slices of src, which must outlive the stream.
+TokenStream *TokenStream_create(Arena *arena, const char *src, long src_size) {
+	TokenStream *stream = Arena_alloc(arena, sizeof(TokenStream));
+	check_mem(stream);
+	mem_arena(arena, MEM_TOKENS, sizeof(TokenStream));
+
+	memset(stream, 0, sizeof(TokenStream));
+	stream->arena = arena;
+	stream->src = src;
+	stream->src_size = src_size;
+
+	return stream;
+error:
+	return NULL;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Everything else is in the arena.
+void TokenStream_release(TokenStream *stream) {
+	if (stream->map) {
+		munmap(stream->map, stream->map_size);
+		stream->map = NULL;
+	}
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Double one of the stream's indexes (starting at initial elements) in
+// the arena. Returns the new array, or NULL with *max unchanged.
+static void *TokenStream_grow(TokenStream *stream, void *ptr, int *max, size_t element_size, int initial) {
+	int new_max = *max ? *max * 2 : initial;
+
+	void *grown = Arena_realloc(stream->arena, ptr, *max * element_size, new_max * element_size);
+	if (grown) {
+		mem_arena(stream->arena, MEM_TOKENS, new_max * element_size);
+		*max = new_max;
+	}
+
+	return grown;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Room for the next TOKEN_CHUNK_SIZE tokens.
+static int TokenStream_add_chunk(TokenStream *stream) {
+	if (stream->chunk_count == stream->chunk_max) {
+		TokenChunk **chunks = TokenStream_grow(stream, stream->chunks, &stream->chunk_max, sizeof(TokenChunk *), 8);
+		if (chunks == NULL)
+			return -1;
+		stream->chunks = chunks;
+	}
+
+	TokenChunk *chunk = Arena_alloc(stream->arena, sizeof(TokenChunk));
+	if (chunk == NULL)
+		return -1;
+	mem_arena(stream->arena, MEM_TOKENS, sizeof(TokenChunk));
+
+	stream->chunks[stream->chunk_count++] = chunk;
+	trace(TRACE_STREAM, STREAM_CHUNK, stream->count, stream->chunk_count, 0);
+	return 0;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static int TokenStream_add_value(TokenStream *stream, int i, int lazy, const char *value) {
+	if (stream->value_count == stream->value_max) {
+		TokenValue *values = TokenStream_grow(stream, stream->values, &stream->value_max, sizeof(TokenValue), 16);
+		if (values == NULL)
+			return -1;
+		stream->values = values;
+	}
+
+	stream->values[stream->value_count].index = i;
+	stream->values[stream->value_count].lazy = lazy;
+	stream->values[stream->value_count].value = value;
+	stream->value_count++;
+	return 0;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+int TokenStream_push_slow(TokenStream *stream, const Token *tok) {
+	int i = stream->count;
+
+	if ((i & TOKEN_CHUNK_MASK) == 0)
+		check(TokenStream_add_chunk(stream) == 0, "Failed to grow token stream.");
+
+	if (tok->value != NULL || tok->lazy)
+		check(TokenStream_add_value(stream, i, tok->lazy, tok->value) == 0, "Failed to grow token values.");
+
+	TokenChunk *chunk = TokenStream_chunk(stream, i);
+	chunk->type[i & TOKEN_CHUNK_MASK] = tok->type;
+	chunk->offset[i & TOKEN_CHUNK_MASK] = tok->offset;
+	chunk->length[i & TOKEN_CHUNK_MASK] = tok->length;
+	chunk->symbol[i & TOKEN_CHUNK_MASK] = tok->symbol;
+	stream->count++;
+
+	return 0;
+error:
+	return -1;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// First of from's values for a token at or after index i.
+static int TokenStream_find_value(TokenStream *from, int i) {
+	int lo = 0, hi = from->value_count;
+
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (from->values[mid].index < i)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Append count of from's tokens starting at first, a chunk's worth at a
+// time, with shift added to their offsets; their source is from's moved
+// by shift. Lazy values stay lazy. Other values are copied into stream's
+// arena, since one read from from may have been built in from's. Returns
+// -1 if the stream couldn't grow, with some of the tokens appended.
+int TokenStream_append(TokenStream *stream, TokenStream *from, int first, int count, long shift) {
+	int i = first, end = first + count;
+	int v = TokenStream_find_value(from, first);
+	int base = stream->count - first;
+
+	while (i < end) {
+		if ((stream->count & TOKEN_CHUNK_MASK) == 0 && TokenStream_add_chunk(stream) != 0)
+			return -1;
+
+		TokenChunk *dst = TokenStream_chunk(stream, stream->count);
+		TokenChunk *src = TokenStream_chunk(from, i);
+		int to = stream->count & TOKEN_CHUNK_MASK, at = i & TOKEN_CHUNK_MASK;
+		int n = end - i, j;
+
+		if (n > TOKEN_CHUNK_SIZE - to)
+			n = TOKEN_CHUNK_SIZE - to;
+		if (n > TOKEN_CHUNK_SIZE - at)
+			n = TOKEN_CHUNK_SIZE - at;
+
+		memcpy(dst->type + to, src->type + at, n);
+		memcpy(dst->length + to, src->length + at, n * sizeof(uint32_t));
+		memcpy(dst->symbol + to, src->symbol + at, n * sizeof(uint32_t));
+		for (j = 0; j < n; j++)
+			dst->offset[to + j] = src->offset[at + j] + shift;
+
+		stream->count += n;
+		i += n;
+	}
+
+	for (; v < from->value_count && from->values[v].index < end; v++) {
+		TokenValue *value = &from->values[v];
+		const char *copy = NULL;
+
+		if (!value->lazy) {
+			copy = Arena_strndup(stream->arena, value->value, TokenStream_length(from, value->index));
+			if (copy == NULL)
+				return -1;
+			mem_arena(stream->arena, MEM_TOKENS, TokenStream_length(from, value->index) + 1);
+		}
+
+		if (TokenStream_add_value(stream, value->index + base, value->lazy, copy) != 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// The source's line index, built the first time it's asked for. NULL if
+// it can't be.
+LineIndex *TokenStream_lines(TokenStream *stream) {
+	if (stream->lines == NULL)
+		stream->lines = LineIndex_create(stream->src, stream->src_size, stream->arena);
+
+	return stream->lines;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Line of token i, or 0 without a line index.
+int TokenStream_line(TokenStream *stream, int i) {
+	LineIndex *lines = TokenStream_lines(stream);
+
+	return lines ? LineIndex_line(lines, TokenStream_offset(stream, i)) : 0;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Random access to token i. Walking the stream is cheaper with TokenIter.
+void TokenStream_get(TokenStream *stream, int i, Token *tok) {
+	tok->type = TokenStream_type(stream, i);
+	tok->offset = TokenStream_offset(stream, i);
+	tok->length = TokenStream_length(stream, i);
+	tok->symbol = TokenStream_symbol(stream, i);
+	tok->line = TokenStream_line(stream, i);
+	tok->value = NULL;
+	tok->lazy = LAZY_NONE;
+
+	int lo = 0, hi = stream->value_count;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		TokenValue *tv = &stream->values[mid];
+
+		if (tv->index == i) {
+			tok->value = tv->value;
+			tok->lazy = tv->lazy;
+			if (tok->lazy)
+				TokenStream_materialize(stream, tv, tok);
+			break;
+		} else if (tv->index < i) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Build the value of lazy token tok, which is token value->index, and
+// keep it so it's only built once. If there's no memory for it tok is
+// left as the raw slice.
+void TokenStream_materialize(TokenStream *stream, TokenValue *value, Token *tok) {
+	int i = value->index;
+
+	if (Token_materialize(tok, stream->src, stream->arena) != 0)
+		return;
+
+	value->value = tok->value;
+	value->lazy = LAZY_NONE;
+	TokenStream_chunk(stream, i)->length[i & TOKEN_CHUNK_MASK] = tok->length;
+}
@@ -0,0 +1,186 @@
+#ifndef _MANANA_STREAM_H
+#define _MANANA_STREAM_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "debug.h"
+#include "arena.h"
+#include "tokens.h"
+#include "lines.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Tokens are stored as parallel arrays (type, offset, length, symbol) in fixed-size
+// chunks allocated from an Arena, 13 bytes a token. Passes that only care
+// about token types can walk the dense type bytes of each chunk without
+// touching the rest.
+// Appending never moves a token and a token's index stays valid for the
+// life of the stream. Everything, the indexes included, lives in the arena
+// and goes away with it.
+//
+// The implied and lazy values (Token.value, Token.lazy) are kept on the
+// side, by token index, because few tokens have them. Lines aren't kept
+// at all: a token's line is the line of its offset, looked up in a
+// LineIndex of the source that's built the first time one is wanted.
+//
+// Lazy values and the line index are built into the arena on first read,
+// which updates the stream; two threads mustn't read the same stream until
+// it has been read once.
+//
+// A stream loaded from a token cache (see cache.h) has its chunks in the
+// cache's mapping instead, which is map; TokenStream_release unmaps it.
+#define TOKEN_CHUNK_BITS 10
+#define TOKEN_CHUNK_SIZE (1 << TOKEN_CHUNK_BITS)
+#define TOKEN_CHUNK_MASK (TOKEN_CHUNK_SIZE - 1)
+
+typedef struct TokenChunk {
+	uint8_t type[TOKEN_CHUNK_SIZE];
+	uint32_t offset[TOKEN_CHUNK_SIZE];
+	uint32_t length[TOKEN_CHUNK_SIZE];
+	uint32_t symbol[TOKEN_CHUNK_SIZE];
+} TokenChunk;
+
+typedef struct TokenValue {
+	int index, lazy;
+	const char *value;
+} TokenValue;
+
+typedef struct TokenStream {
+	Arena *arena;
+	const char *src;
+	long src_size;
+	LineIndex *lines;
+	TokenChunk **chunks;
+	TokenValue *values;
+	int count, chunk_count, chunk_max, value_count, value_max;
+	void *map;
+	size_t map_size;
+} TokenStream;
+
+// lines is NULL, and every line 0, for a raw iterator (which also leaves
+// lazy values lazy) or if the line index couldn't be built.
+typedef struct TokenIter {
+	TokenStream *stream;
+	LineIndex *lines;
+	int index, line, value, raw;
+} TokenIter;
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+TokenStream *TokenStream_create(Arena *arena, const char *src, long src_size);
+void TokenStream_release(TokenStream *stream);
+int TokenStream_push_slow(TokenStream *stream, const Token *tok);
+int TokenStream_append(TokenStream *stream, TokenStream *from, int first, int count, long shift);
+LineIndex *TokenStream_lines(TokenStream *stream);
+void TokenStream_materialize(TokenStream *stream, TokenValue *value, Token *tok);
+int TokenStream_line(TokenStream *stream, int i);
+void TokenStream_get(TokenStream *stream, int i, Token *tok);
+
+#define TokenStream_count(S) ((S)->count)
+
+#define TokenStream_chunk(S, I) ((S)->chunks[(I) >> TOKEN_CHUNK_BITS])
+
+#define TOKENS_EACH(STREAM, CUR)\
+	TokenIter _it = TokenStream_iter(STREAM);\
+	Token CUR;\
+	while (TokenIter_next(&_it, &CUR))
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static inline TokenType TokenStream_type(TokenStream *stream, int i) {
+	return TokenStream_chunk(stream, i)->type[i & TOKEN_CHUNK_MASK];
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static inline int TokenStream_offset(TokenStream *stream, int i) {
+	return TokenStream_chunk(stream, i)->offset[i & TOKEN_CHUNK_MASK];
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static inline int TokenStream_length(TokenStream *stream, int i) {
+	return TokenStream_chunk(stream, i)->length[i & TOKEN_CHUNK_MASK];
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static inline uint32_t TokenStream_symbol(TokenStream *stream, int i) {
+	return TokenStream_chunk(stream, i)->symbol[i & TOKEN_CHUNK_MASK];
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Type bytes of the chunk holding token i, and how many of them are used.
+static inline const uint8_t *TokenStream_types(TokenStream *stream, int i, int *count) {
+	int first = i & ~TOKEN_CHUNK_MASK;
+	int left = stream->count - first;
+
+	*count = left < TOKEN_CHUNK_SIZE ? left : TOKEN_CHUNK_SIZE;
+	return TokenStream_chunk(stream, i)->type;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Append a token; its line is ignored. The fast path only writes the four
+// arrays; new chunks and implied or lazy values go through
+// TokenStream_push_slow. Returns -1 if the stream couldn't grow.
+static inline int TokenStream_push(TokenStream *stream, const Token *tok) {
+	int i = stream->count;
+
+	if ((i & TOKEN_CHUNK_MASK) == 0 || tok->value != NULL || tok->lazy)
+		return TokenStream_push_slow(stream, tok);
+
+	TokenChunk *chunk = TokenStream_chunk(stream, i);
+	chunk->type[i & TOKEN_CHUNK_MASK] = tok->type;
+	chunk->offset[i & TOKEN_CHUNK_MASK] = tok->offset;
+	chunk->length[i & TOKEN_CHUNK_MASK] = tok->length;
+	chunk->symbol[i & TOKEN_CHUNK_MASK] = tok->symbol;
+	stream->count++;
+	return 0;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static inline TokenIter TokenStream_iter(TokenStream *stream) {
+	TokenIter it = { stream, TokenStream_lines(stream), 0, 1, 0, 0 };
+	return it;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Tokens exactly as stored, lazy values unread and lines 0, so reading
+// them changes nothing.
+static inline TokenIter TokenStream_iter_raw(TokenStream *stream) {
+	TokenIter it = { stream, NULL, 0, 0, 0, 1 };
+	return it;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Read the next token into tok. Returns 0 at the end of the stream.
+static inline int TokenIter_next(TokenIter *it, Token *tok) {
+	TokenStream *stream = it->stream;
+	int i = it->index;
+
+	if (i >= stream->count)
+		return 0;
+
+	TokenChunk *chunk = TokenStream_chunk(stream, i);
+	tok->type = chunk->type[i & TOKEN_CHUNK_MASK];
+	tok->offset = chunk->offset[i & TOKEN_CHUNK_MASK];
+	tok->length = chunk->length[i & TOKEN_CHUNK_MASK];
+	tok->symbol = chunk->symbol[i & TOKEN_CHUNK_MASK];
+
+	if (it->lines)
+		it->line = LineIndex_seek(it->lines, it->line, tok->offset);
+	tok->line = it->lines ? it->line : 0;
+
+	tok->value = NULL;
+	tok->lazy = LAZY_NONE;
+	if (it->value < stream->value_count) {
+		TokenValue *value = &stream->values[it->value];
+		if (value->index == i) {
+			tok->value = value->value;
+			tok->lazy = value->lazy;
+			if (tok->lazy && !it->raw)
+				TokenStream_materialize(stream, value, tok);
+			it->value++;
+		}
+	}
+
+	it->index++;
+	return 1;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+#endif
@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "debug.h"
+#include "symbols.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static const struct { const char *name; int length; } builtin_symbols[] = {
+#define SYMBOL_NAME(N, S) { S, sizeof(S) - 1 },
+	BUILTIN_SYMBOLS(SYMBOL_NAME)
+#undef SYMBOL_NAME
+};
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// FNV-1a; names are short.
+static inline uint32_t symbol_hash(const char *str, int length) {
+	uint32_t hash = 2166136261u;
+	int i;
+
+	for (i = 0; i < length; i++)
+		hash = (hash ^ (unsigned char)str[i]) * 16777619u;
+
+	return hash;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Slot holding str, or the empty slot where it would go.
+static inline uint32_t SymbolTable_slot(SymbolTable *table, const char *str, int length, uint32_t hash) {
+	uint32_t i = hash & table->slot_mask;
+
+	for (;;) {
+		Symbol symbol = table->slots[i];
+		if (symbol == SYM_NONE)
+			return i;
+
+		SymbolEntry *entry = &table->entries[symbol];
+		if (entry->hash == hash && entry->length == (uint32_t)length && memcmp(entry->name, str, length) == 0)
+			return i;
+
+		i = (i + 1) & table->slot_mask;
+	}
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Double the slots once they're half full.
+static int SymbolTable_rehash(SymbolTable *table) {
+	int size = table->slot_mask ? (table->slot_mask + 1) * 2 : 256;
+	Symbol *slots = calloc(size, sizeof(Symbol));
+	check_mem(slots);
+	mem_realloc(MEM_SYMBOLS, table->slot_mask ? (table->slot_mask + 1) * sizeof(Symbol) : 0, size * sizeof(Symbol));
+
+	free(table->slots);
+	table->slots = slots;
+	table->slot_mask = size - 1;
+
+	Symbol symbol;
+	for (symbol = 1; symbol <= (Symbol)table->count; symbol++) {
+		SymbolEntry *entry = &table->entries[symbol];
+		table->slots[SymbolTable_slot(table, entry->name, entry->length, entry->hash)] = symbol;
+	}
+
+	return 0;
+error:
+	return -1;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Find or add str. The caller holds the write lock, if there is one.
+static Symbol SymbolTable_insert(SymbolTable *table, const char *str, int length, uint32_t hash) {
+	if ((table->count + 1) * 2 > table->slot_mask + 1)
+		check(SymbolTable_rehash(table) == 0, "Failed to grow symbol table.");
+
+	uint32_t slot = SymbolTable_slot(table, str, length, hash);
+	if (table->slots[slot] != SYM_NONE)
+		return table->slots[slot];
+
+	if (table->count + 1 == table->max) {
+		int max = table->max * 2;
+		SymbolEntry *entries = realloc(table->entries, max * sizeof(SymbolEntry));
+		check_mem(entries);
+		mem_realloc(MEM_SYMBOLS, table->max * sizeof(SymbolEntry), max * sizeof(SymbolEntry));
+
+		table->entries = entries;
+		table->max = max;
+	}
+
+	char *name = Arena_strndup(table->arena, str, length);
+	check_mem(name);
+	mem_arena(table->arena, MEM_SYMBOLS, length + 1);
+
+	Symbol symbol = ++table->count;
+	table->entries[symbol].name = name;
+	table->entries[symbol].length = length;
+	table->entries[symbol].hash = hash;
+	table->slots[slot] = symbol;
+
+	return symbol;
+error:
+	return SYM_NONE;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+SymbolTable *SymbolTable_create(int concurrent) {
+	int i;
+
+	SymbolTable *table = calloc(1, sizeof(SymbolTable));
+	check_mem(table);
+
+	table->arena = Arena_create(0);
+	check_mem(table->arena);
+
+	table->max = 256;
+	table->entries = calloc(table->max, sizeof(SymbolEntry));
+	check_mem(table->entries);
+	mem_alloc(MEM_SYMBOLS, sizeof(SymbolTable) + table->max * sizeof(SymbolEntry));
+
+	check(SymbolTable_rehash(table) == 0, "Failed to create symbol table.");
+
+	for (i = 0; i < SYM_BUILTIN_COUNT - 1; i++)
+		SymbolTable_insert(table, builtin_symbols[i].name, builtin_symbols[i].length,
+				symbol_hash(builtin_symbols[i].name, builtin_symbols[i].length));
+
+	table->concurrent = concurrent;
+	if (concurrent)
+		check(pthread_rwlock_init(&table->lock, NULL) == 0, "Failed to create symbol table lock.");
+
+	return table;
+error:
+	if (table)
+		table->concurrent = 0;
+	SymbolTable_destroy(table);
+	return NULL;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+void SymbolTable_destroy(SymbolTable *table) {
+	if (table == NULL)
+		return;
+
+	if (table->concurrent)
+		pthread_rwlock_destroy(&table->lock);
+
+	if (table->entries)
+		mem_free(MEM_SYMBOLS, sizeof(SymbolTable) + table->max * sizeof(SymbolEntry));
+	if (table->slots)
+		mem_free(MEM_SYMBOLS, (table->slot_mask + 1) * sizeof(Symbol));
+
+	Arena_destroy(table->arena);
+	free(table->entries);
+	free(table->slots);
+	free(table);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// The symbol for str, added if it's new. Returns SYM_NONE only if the
+// table couldn't grow.
+Symbol SymbolTable_intern(SymbolTable *table, const char *str, int length) {
+	uint32_t hash = symbol_hash(str, length);
+	Symbol symbol;
+
+	if (!table->concurrent)
+		return SymbolTable_insert(table, str, length, hash);
+
+	pthread_rwlock_rdlock(&table->lock);
+	symbol = table->slots[SymbolTable_slot(table, str, length, hash)];
+	pthread_rwlock_unlock(&table->lock);
+
+	if (symbol != SYM_NONE)
+		return symbol;
+
+	// Someone may have added it in between; insert finds it if so.
+	pthread_rwlock_wrlock(&table->lock);
+	symbol = SymbolTable_insert(table, str, length, hash);
+	pthread_rwlock_unlock(&table->lock);
+
+	return symbol;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Name of symbol, NUL-terminated; length is set if it's not NULL.
+const char *SymbolTable_name(SymbolTable *table, Symbol symbol, int *length) {
+	const char *name = NULL;
+	int len = 0;
+
+	if (table->concurrent)
+		pthread_rwlock_rdlock(&table->lock);
+
+	if (symbol != SYM_NONE && symbol <= (Symbol)table->count) {
+		name = table->entries[symbol].name;
+		len = table->entries[symbol].length;
+	}
+
+	if (table->concurrent)
+		pthread_rwlock_unlock(&table->lock);
+
+	if (length)
+		*length = len;
+	return name;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+int SymbolTable_count(SymbolTable *table) {
+	int count;
+
+	if (table->concurrent)
+		pthread_rwlock_rdlock(&table->lock);
+
+	count = table->count;
+
+	if (table->concurrent)
+		pthread_rwlock_unlock(&table->lock);
+
+	return count;
+}
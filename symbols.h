@@ -0,0 +1,52 @@
+#ifndef _MANANA_SYMBOLS_H
+#define _MANANA_SYMBOLS_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include "arena.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Names every table interns first, so they have the same symbol in every
+// table and later stages can compare against them as constants.
+#define BUILTIN_SYMBOLS(X)\
+	X(DIV, "div") X(A, "a") X(IMG, "img") X(HREF, "href") X(SRC, "src")\
+	X(ID, "id") X(CLASS, "class") X(STYLE, "style") X(TYPE, "type") X(NAME, "name")
+
+#define SYMBOL_ENUM(N, S) SYM_##N,
+enum { SYM_NONE, BUILTIN_SYMBOLS(SYMBOL_ENUM) SYM_BUILTIN_COUNT };
+#undef SYMBOL_ENUM
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Interned names: each distinct string gets a small integer, its Symbol,
+// so names can be compared with == and memory grows with the vocabulary
+// instead of the corpus. Symbol 0 is no symbol.
+//
+// A table can be shared by any number of Buffers. One created concurrent
+// can also be shared across threads: lookups take a read lock and only
+// new names take the write lock. Names are copied into the table's arena,
+// so a Symbol's name stays valid for the life of the table.
+typedef uint32_t Symbol;
+
+typedef struct SymbolEntry {
+	const char *name;
+	uint32_t length, hash;
+} SymbolEntry;
+
+typedef struct SymbolTable {
+	Arena *arena;
+	SymbolEntry *entries;
+	Symbol *slots;
+	int count, max, slot_mask;
+	int concurrent;
+	pthread_rwlock_t lock;
+} SymbolTable;
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+SymbolTable *SymbolTable_create(int concurrent);
+Symbol SymbolTable_intern(SymbolTable *table, const char *str, int length);
+const char *SymbolTable_name(SymbolTable *table, Symbol symbol, int *length);
+int SymbolTable_count(SymbolTable *table);
+void SymbolTable_destroy(SymbolTable *table);
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+#endif
@@ -2,5 +2,5 @@
 
 make clean
 make
-./manana
-#valgrind ./manana
+./manana examples/0.basics.manana
+#valgrind ./manana examples/0.basics.manana
@@ -0,0 +1,216 @@
+// Differential test of the two lexers: the states in lexer.c and the DFA
+// generated from lexer.grammar (see dfa.h).
+//
+//     make test
+//     test/dfatest [-n mutations] [file ...]
+//
+// Every input is lexed with both and everything a consumer could observe
+// compared: each token's type, offset, length, line, symbol and value, the
+// resync points, and the error if there is one. The inputs are the files
+// (the examples and bench/page.manana without any), every mix in
+// bench/corpus.h at a few seeds, and mutations of small generated
+// templates, random pieces of syntax pasted into and cut out of them; most
+// of those don't lex, so the errors are compared as much as the tokens.
+// Exits 1 on any difference.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lexer.h"
+#include "source.h"
+#include "bench/corpus.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static const char *const pieces[] = {
+	"\n", "    ", "\t", " ", "div", "a", "p.x", "#id", ".c", "(", ")", "(a=\"b\")", "(*k='v')",
+	"=", "->", "\"", "'", "\\", "\\\"", "@{", "}", "@{x.y[0]}", "@", "\"\"\"", ":text", ":text\n",
+	"-if ", "-elif a == 1", "-else", "-for x in y", "-each e", "-alias a as b", "-iff", "-case", "-with x", "-",
+	"==", "!=", ">=", "<", "!", "%", "1.5", "Int", "not", "exists", "in", "_", "[", "]", "x",
+};
+
+#define PIECE_COUNT (int)(sizeof(pieces) / sizeof(pieces[0]))
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static Buffer *lex(char *src, long size, LexerBackend backend, SymbolTable *symbols) {
+	Buffer *buf = Buffer_create(src, size);
+	if (buf == NULL)
+		return NULL;
+
+	buf->backend = backend;
+	buf->symbols = symbols;
+	buf->track_resync = 1;
+	tokenize(buf);
+	return buf;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Where hand and dfa first differ, described in diff, or 0 if they don't.
+static int differ(Buffer *hand, Buffer *dfa, char *diff, size_t size) {
+	int count = TokenStream_count(hand->stream), i;
+
+	if (hand->error != dfa->error || (hand->error && (hand->error_line != dfa->error_line
+			|| hand->error_column != dfa->error_column || strcmp(hand->error_message, dfa->error_message) != 0))) {
+		snprintf(diff, size, "error %d:%d \"%s\" vs %d:%d \"%s\"",
+				hand->error_line, hand->error_column, hand->error ? hand->error_message : "",
+				dfa->error_line, dfa->error_column, dfa->error ? dfa->error_message : "");
+		return 1;
+	}
+
+	if (count != TokenStream_count(dfa->stream)) {
+		snprintf(diff, size, "%d tokens vs %d", count, TokenStream_count(dfa->stream));
+		return 1;
+	}
+
+	for (i = 0; i < count; i++) {
+		Token a, b;
+
+		TokenStream_get(hand->stream, i, &a);
+		TokenStream_get(dfa->stream, i, &b);
+
+		if (a.type != b.type || a.offset != b.offset || a.length != b.length || a.line != b.line
+				|| a.symbol != b.symbol || memcmp(Token_value(&a, hand->src), Token_value(&b, dfa->src), a.length) != 0) {
+			snprintf(diff, size, "token %d: %s \"%.*s\" at %d vs %s \"%.*s\" at %d", i,
+					tokens[a.type], a.length, Token_value(&a, hand->src), a.offset,
+					tokens[b.type], b.length, Token_value(&b, dfa->src), b.offset);
+			return 1;
+		}
+	}
+
+	if (hand->resync_count != dfa->resync_count
+			|| memcmp(hand->resync, dfa->resync, hand->resync_count * sizeof(ResyncPoint)) != 0) {
+		snprintf(diff, size, "resync points differ");
+		return 1;
+	}
+
+	return 0;
+}
+
+// Lexes src with both and reports any difference. Returns 1 if there was
+// one, -1 if it couldn't lex at all.
+static int compare(const char *name, char *src, long size, SymbolTable *symbols, long *errors) {
+	Buffer *hand = lex(src, size, LEXER_HAND, symbols);
+	Buffer *dfa = lex(src, size, LEXER_DFA, symbols);
+	// Room for both error messages and the text around them.
+	char diff[2 * MANANA_ERROR_LENGTH + 64];
+	int rc = -1;
+
+	check_mem(hand && dfa);
+
+	*errors += hand->error != 0;
+	rc = differ(hand, dfa, diff, sizeof(diff));
+	if (rc)
+		log_err("%s: %s", name, diff);
+
+error:
+	Buffer_destroy(hand);
+	Buffer_destroy(dfa);
+	return rc;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// A copy of src with one to four pieces pasted in or runs cut out, padded
+// like a Source.
+static char *mutate(const char *src, long size, long *mutated) {
+	char *copy = calloc(size + 4 * 16 + SOURCE_PADDING, 1);
+	int edits = 1 + rand() % 4, i;
+
+	if (copy == NULL)
+		return NULL;
+	memcpy(copy, src, size);
+
+	for (i = 0; i < edits; i++) {
+		long at = rand() % (size + 1);
+
+		if (rand() % 3) {
+			const char *piece = pieces[rand() % PIECE_COUNT];
+			long length = strlen(piece);
+
+			memmove(copy + at + length, copy + at, size - at);
+			memcpy(copy + at, piece, length);
+			size += length;
+		} else {
+			long length = rand() % 8;
+			if (length > size - at)
+				length = size - at;
+
+			memmove(copy + at, copy + at + length, size - at - length);
+			size -= length;
+			memset(copy + size, 0, length);
+		}
+	}
+
+	*mutated = size;
+	return copy;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+int main(int argc, char *argv[]) {
+	const char *paths[argc + 2];
+	SymbolTable *symbols = SymbolTable_create(0);
+	long checked = 0, errors = 0, mutated_errors = 0;
+	int mutations = 2000, files = 0, mismatches = 0;
+	int i, mix, seed;
+
+	check_mem(symbols);
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			mutations = atoi(argv[++i]);
+		} else {
+			paths[files++] = argv[i];
+		}
+	}
+
+	if (files == 0) {
+		paths[files++] = "examples/0.basics.manana";
+		paths[files++] = "examples/1.logic.manana";
+		paths[files++] = "bench/page.manana";
+	}
+
+	for (i = 0; i < files; i++) {
+		Source *source = Source_open(paths[i]);
+		check(source, "Can't read %s", paths[i]);
+
+		mismatches += compare(paths[i], source->data, source->size, symbols, &errors) != 0;
+		checked++;
+		Source_close(source);
+	}
+
+	for (mix = 0; mix < CORPUS_MIX_COUNT; mix++) {
+		for (seed = 1; seed <= 4; seed++) {
+			long generated;
+			char *src = Corpus_generate(mix, 64 << 10, seed, &generated);
+			check_mem(src);
+
+			mismatches += compare(Corpus_mix_name(mix), src, generated, symbols, &errors) != 0;
+			checked++;
+			free(src);
+		}
+	}
+
+	// Mutations of a small template of every mix in turn.
+	srand(7);
+	for (i = 0; i < mutations; i++) {
+		long generated, mutated;
+		char *src = Corpus_generate(i % CORPUS_MIX_COUNT, 2 << 10, 1 + i / CORPUS_MIX_COUNT % 8, &generated);
+		char *copy = src ? mutate(src, generated, &mutated) : NULL;
+		char name[64];
+
+		check_mem(copy);
+		snprintf(name, sizeof(name), "%s mutation %d", Corpus_mix_name(i % CORPUS_MIX_COUNT), i);
+
+		if (compare(name, copy, mutated, symbols, &mutated_errors) != 0 && mismatches++ > 20)
+			i = mutations;
+		free(src);
+		free(copy);
+	}
+
+	printf("dfatest: %ld templates (%ld not lexing), %d mutations (%ld not lexing), %d mismatches\n",
+			checked, errors, mutations, mutated_errors, mismatches);
+
+	SymbolTable_destroy(symbols);
+	return mismatches != 0;
+error:
+	SymbolTable_destroy(symbols);
+	return 1;
+}
@@ -0,0 +1,39 @@
+#include <string.h>
+#include "digest.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static uint64_t fnv(uint64_t h, const void *data, size_t size) {
+	const unsigned char *p = data;
+	while (size--)
+		h = (h ^ *p++) * 0x100000001b3ULL;
+	return h;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+uint64_t Digest_tokens(Buffer *buf, int count) {
+	uint64_t h = 0xcbf29ce484222325ULL;
+
+	h = fnv(h, &count, sizeof(count));
+
+	TOKENS_EACH(buf->stream, tok) {
+		int fields[4] = { tok.type, tok.offset, tok.length, tok.line };
+		h = fnv(h, fields, sizeof(fields));
+		h = fnv(h, Token_value(&tok, buf->src), tok.length);
+
+		if (buf->symbols && Token_has_symbol(tok.type)) {
+			int length, same;
+			const char *name = SymbolTable_name(buf->symbols, tok.symbol, &length);
+
+			same = name && length == tok.length && memcmp(name, Token_value(&tok, buf->src), length) == 0;
+			h = fnv(h, &same, sizeof(same));
+		}
+	}
+
+	if (count < 0) {
+		h = fnv(h, &buf->error_line, sizeof(buf->error_line));
+		h = fnv(h, &buf->error_column, sizeof(buf->error_column));
+		h = fnv(h, buf->error_message, strlen(buf->error_message));
+	}
+
+	return h;
+}
@@ -0,0 +1,18 @@
+#ifndef _MANANA_DIGEST_H
+#define _MANANA_DIGEST_H
+
+#include <stdint.h>
+#include "lexer.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// A hash of everything a consumer of a lexed Buffer could observe: the
+// count tokenize returned, each token's type, position, line and value,
+// and the error if there was one. Two lexes agree on it exactly when they
+// produced the same stream.
+//
+// Symbols depend on the order names were first interned in, so only
+// whether each one names its token's value goes into the hash.
+uint64_t Digest_tokens(Buffer *buf, int count);
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+#endif
@@ -0,0 +1,125 @@
+// Split test: lexes templates with tokenize_split at several thread counts
+// and chunk sizes, into a concurrent and into a plain SymbolTable, and
+// checks every stream (or error) is the one tokenize gives.
+//
+//     make test
+//     test/splittest [file ...]
+//
+// Without files it repeats test/split.manana, whose """ comments, :filter
+// blocks and strings cross column-0 lines, so that many of the guessed
+// chunk boundaries are wrong. Each source is also tried starting indented,
+// which changes where lex_eof dedents to, and with an error at the end,
+// which every chunk after the first has to reach. Exits 1 if any stream
+// differs.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "lexer.h"
+#include "source.h"
+#include "split.h"
+#include "debug.h"
+#include "digest.h"
+
+#define SPLIT_TEST_SIZE (256 * 1024)
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static uint64_t lex_digest(char *src, long size, SymbolTable *symbols, int threads, long chunk_size) {
+	Buffer *buf = Buffer_create(src, size);
+	if (buf == NULL)
+		return 0;
+
+	buf->symbols = symbols;
+	int count = threads > 1 ? tokenize_split(buf, threads, chunk_size) : tokenize(buf);
+	uint64_t h = Digest_tokens(buf, count);
+
+	Buffer_destroy(buf);
+	return h;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static int test(const char *name, char *src, long size) {
+	static const int thread_counts[] = { 2, 4 };
+	static const long chunk_sizes[] = { 64, 333, 4096, 65536 };
+	SymbolTable *tables[2] = { SymbolTable_create(0), SymbolTable_create(1) };
+	int i, j, k, runs = 0, mismatches = 0;
+
+	if (tables[0] == NULL || tables[1] == NULL) {
+		SymbolTable_destroy(tables[0]);
+		SymbolTable_destroy(tables[1]);
+		return 1;
+	}
+
+	uint64_t expected = lex_digest(src, size, tables[0], 1, 0);
+
+	for (i = 0; i < 2; i++) {
+		for (j = 0; j < (int)(sizeof(thread_counts) / sizeof(thread_counts[0])); j++) {
+			for (k = 0; k < (int)(sizeof(chunk_sizes) / sizeof(chunk_sizes[0])); k++) {
+				if (lex_digest(src, size, tables[i], thread_counts[j], chunk_sizes[k]) != expected) {
+					printf("splittest: %s differs, %s table, %d threads, %ld B chunks\n",
+							name, i ? "concurrent" : "plain", thread_counts[j], chunk_sizes[k]);
+					mismatches++;
+				}
+				runs++;
+			}
+		}
+	}
+
+	printf("splittest: %s, %ld bytes, %d splits, %d mismatches\n", name, size, runs, mismatches);
+
+	SymbolTable_destroy(tables[0]);
+	SymbolTable_destroy(tables[1]);
+	return mismatches > 0;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Repeat the template at path to about SPLIT_TEST_SIZE and test it as is,
+// indented and with an error at the end.
+static int test_path(const char *path) {
+	static const char *error = "p @{a-b}\n";
+	Source *source = Source_open(path);
+	char *src = NULL;
+	long copies, size = 0;
+	int i, failed = 0;
+
+	check(source && source->size > 0, "Can't load %s", path);
+
+	copies = SPLIT_TEST_SIZE / source->size + 1;
+	src = calloc(copies * source->size + strlen(error) + SOURCE_PADDING, 1);
+	check_mem(src);
+
+	for (i = 0; i < copies; i++, size += source->size)
+		memcpy(src + size, source->data, source->size);
+
+	failed |= test(path, src, size);
+
+	memcpy(src + size, error, strlen(error));
+	failed |= test("  with an error", src, size + strlen(error));
+	memset(src + size, 0, strlen(error));
+
+	if (src[0] != ' ') {
+		src[0] = ' ';
+		failed |= test("  indented", src, size);
+	}
+
+	free(src);
+	Source_close(source);
+	return failed;
+error:
+	Source_close(source);
+	return 1;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+int main(int argc, char *argv[]) {
+	int i, failed = 0;
+
+	if (argc < 2)
+		return test_path("test/split.manana");
+
+	for (i = 1; i < argc; i++)
+		failed |= test_path(argv[i]);
+
+	return failed ? 1 : 0;
+}
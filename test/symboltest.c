@@ -0,0 +1,164 @@
+// Concurrent SymbolTable test: several threads intern the same vocabulary
+// into one concurrent table at once, each in its own order, so that
+// lookups race with inserts and with the table growing. Checks that every
+// thread gets the same symbol for a name, that each symbol names what was
+// interned, that the count never goes down and ends at one per distinct
+// name, and that the builtin names keep their SYM_* values.
+//
+//     make test
+//     test/symboltest [-t threads] [-n rounds]
+//
+// Exits 1 on any failure.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "symbols.h"
+#include "debug.h"
+
+#define SYMBOL_TEST_NAMES 20000
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+typedef struct Worker {
+	pthread_t thread;
+	SymbolTable *table;
+	int index, threads;
+	Symbol *symbols;
+	int failures;
+} Worker;
+
+static char names[SYMBOL_TEST_NAMES][16];
+
+static const struct { const char *name; Symbol symbol; } builtins[] = {
+#define SYMBOL_BUILTIN(N, S) { S, SYM_##N },
+	BUILTIN_SYMBOLS(SYMBOL_BUILTIN)
+#undef SYMBOL_BUILTIN
+};
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static void *worker_run(void *arg) {
+	Worker *worker = arg;
+	int i, count = 0;
+
+	for (i = 0; i < SYMBOL_TEST_NAMES; i++) {
+		// Every thread starts at its own place and odd ones go backwards,
+		// so most names are first interned by a thread that races others.
+		int n = (worker->index * (SYMBOL_TEST_NAMES / worker->threads) + i) % SYMBOL_TEST_NAMES;
+		if (worker->index % 2)
+			n = SYMBOL_TEST_NAMES - 1 - n;
+
+		int length = strlen(names[n]), name_length;
+		Symbol symbol = SymbolTable_intern(worker->table, names[n], length);
+		const char *name = SymbolTable_name(worker->table, symbol, &name_length);
+
+		if (symbol < SYM_BUILTIN_COUNT || name == NULL || name_length != length || memcmp(name, names[n], length) != 0)
+			worker->failures++;
+		worker->symbols[n] = symbol;
+
+		int now = SymbolTable_count(worker->table);
+		if (now < count)
+			worker->failures++;
+		count = now;
+	}
+
+	for (i = 0; i < (int)(sizeof(builtins) / sizeof(builtins[0])); i++) {
+		if (SymbolTable_intern(worker->table, builtins[i].name, strlen(builtins[i].name)) != builtins[i].symbol)
+			worker->failures++;
+	}
+
+	return NULL;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static int round_run(int threads) {
+	SymbolTable *table = SymbolTable_create(1);
+	Worker *workers = calloc(threads, sizeof(Worker));
+	char *seen = calloc(SYMBOL_TEST_NAMES + SYM_BUILTIN_COUNT, 1);
+	int i, n, started = 0, failures = 0;
+
+	check_mem(table && workers && seen);
+
+	for (started = 0; started < threads; started++) {
+		Worker *worker = &workers[started];
+
+		worker->table = table;
+		worker->index = started;
+		worker->threads = threads;
+		worker->symbols = calloc(SYMBOL_TEST_NAMES, sizeof(Symbol));
+		check_mem(worker->symbols);
+		check(pthread_create(&worker->thread, NULL, worker_run, worker) == 0,
+				"Can't start thread %d", started);
+	}
+
+	for (i = 0; i < threads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		failures += workers[i].failures;
+	}
+
+	// One symbol per name, the same on every thread.
+	for (n = 0; n < SYMBOL_TEST_NAMES; n++) {
+		Symbol symbol = workers[0].symbols[n];
+
+		for (i = 1; i < threads; i++) {
+			if (workers[i].symbols[n] != symbol)
+				failures++;
+		}
+
+		if (symbol < SYM_BUILTIN_COUNT || symbol >= SYMBOL_TEST_NAMES + SYM_BUILTIN_COUNT || seen[symbol])
+			failures++;
+		else
+			seen[symbol] = 1;
+	}
+
+	if (SymbolTable_count(table) != SYMBOL_TEST_NAMES + SYM_BUILTIN_COUNT - 1)
+		failures++;
+
+	for (i = 0; i < threads; i++)
+		free(workers[i].symbols);
+	free(workers);
+	free(seen);
+	SymbolTable_destroy(table);
+	return failures;
+
+error:
+	// Threads that did start still use the table.
+	for (i = 0; i < started; i++)
+		pthread_join(workers[i].thread, NULL);
+	for (i = 0; workers && i <= started && i < threads; i++)
+		free(workers[i].symbols);
+	free(workers);
+	free(seen);
+	SymbolTable_destroy(table);
+	return 1;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+int main(int argc, char *argv[]) {
+	int threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int rounds = 20;
+	int i, failures = 0;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+			threads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+			rounds = atoi(argv[++i]);
+	}
+
+	// Even on one core, threads that are preempted mid-insert interleave.
+	if (threads < 4)
+		threads = 4;
+
+	for (i = 0; i < SYMBOL_TEST_NAMES; i++)
+		snprintf(names[i], sizeof(names[i]), "name%d", i);
+
+	for (i = 0; i < rounds; i++)
+		failures += round_run(threads);
+
+	printf("symboltest: %d threads, %d rounds of %d names, %d failures\n",
+			threads, rounds, SYMBOL_TEST_NAMES, failures);
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,139 @@
+// Reentrancy test: lexes the same corpus on several threads at once and
+// checks every thread gets exactly the token streams (or errors) a single
+// thread does, so the lexer keeps no shared mutable state. All threads
+// intern into one concurrent SymbolTable, the one piece of state they are
+// meant to share.
+//
+//     make test
+//     test/threadtest [-t threads] [-n iterations] [path ...]
+//
+// Exits 1 if any stream differs.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "lexer.h"
+#include "source.h"
+#include "debug.h"
+#include "digest.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+typedef struct Corpus {
+	Source **sources;
+	uint64_t *expected;
+	int count;
+} Corpus;
+
+typedef struct Worker {
+	pthread_t thread;
+	Corpus *corpus;
+	int iterations, mismatches;
+} Worker;
+
+static SymbolTable *symbols;
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static uint64_t lex_digest(Source *source) {
+	Buffer *buf = Buffer_create(source->data, source->size);
+	if (buf == NULL)
+		return 0;
+
+	buf->symbols = symbols;
+	uint64_t h = Digest_tokens(buf, tokenize(buf));
+
+	Buffer_destroy(buf);
+	return h;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static void *worker_run(void *arg) {
+	Worker *worker = arg;
+	Corpus *corpus = worker->corpus;
+	int i, j;
+
+	for (i = 0; i < worker->iterations; i++) {
+		for (j = 0; j < corpus->count; j++) {
+			if (lex_digest(corpus->sources[j]) != corpus->expected[j])
+				worker->mismatches++;
+		}
+	}
+
+	return NULL;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+int main(int argc, char *argv[]) {
+	int threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int iterations = 2000;
+	int i, mismatches = 0;
+	Array *paths = Array_create(0, 64);
+	Corpus corpus = { NULL, NULL, 0 };
+	Worker *workers = NULL;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+			threads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+			iterations = atoi(argv[++i]);
+		else
+			Source_find(argv[i], ".manana", paths);
+	}
+
+	if (Array_count(paths) == 0) {
+		Source_find("examples", ".manana", paths);
+		Source_find("bench", ".manana", paths);
+	}
+
+	// Even on one core, threads that are preempted mid-lex interleave.
+	if (threads < 4)
+		threads = 4;
+
+	symbols = SymbolTable_create(1);
+	check_mem(symbols);
+
+	corpus.sources = calloc(Array_count(paths), sizeof(Source *));
+	corpus.expected = calloc(Array_count(paths), sizeof(uint64_t));
+	workers = calloc(threads, sizeof(Worker));
+	check_mem(corpus.sources && corpus.expected && workers);
+
+	// The single-threaded result is the reference.
+	for (i = 0; i < Array_count(paths); i++) {
+		Source *source = Source_open(Array_get(paths, i));
+		check(source, "Can't load %s", (char *)Array_get(paths, i));
+
+		corpus.sources[corpus.count] = source;
+		corpus.expected[corpus.count] = lex_digest(source);
+		corpus.count++;
+	}
+
+	for (i = 0; i < threads; i++) {
+		workers[i].corpus = &corpus;
+		workers[i].iterations = iterations;
+		check(pthread_create(&workers[i].thread, NULL, worker_run, &workers[i]) == 0,
+				"Can't start thread %d", i);
+	}
+
+	for (i = 0; i < threads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		mismatches += workers[i].mismatches;
+	}
+
+	printf("threadtest: %d threads, %d files, %d mismatches\n", threads, corpus.count, mismatches);
+
+	for (i = 0; i < corpus.count; i++)
+		Source_close(corpus.sources[i]);
+	for (i = 0; i < Array_count(paths); i++)
+		free(Array_get(paths, i));
+	Array_destroy(paths);
+	free(corpus.sources);
+	free(corpus.expected);
+	free(workers);
+	SymbolTable_destroy(symbols);
+
+	return mismatches ? 1 : 0;
+error:
+	return 1;
+}
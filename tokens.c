@@ -5,61 +5,139 @@
 #include "tokens.h"
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. . 
-int stream_index = 0;
+// Lookup array that matches TokenType enum in tokens.h
+#define TOKEN_NAME(N) #N,
+const char *const tokens[] = { TOKEN_TYPES(TOKEN_NAME) };
+#undef TOKEN_NAME
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. . 
-// Lookup array that matches TokenType enum in tokens.h
-char *tokens[] = {
-    // special
-    "ILLEGAL", "END", "NEWLINE",
-    // whitespace
-    "INDENT", "DEDENT", "SPACE",
-    // boolean
-    "TRUE", "FALSE", "AND", "OR", "NOT",
-    // data types
-    "TYPEHASH", "TYPELIST", "TYPESTRING", "TYPEINT", "TYPENUMBER", "TYPEBOOLEAN",
-    // punctuation
-    "LPAREN", "RPAREN", "LBRACK", "RBRACK", "LBRACE", "RBRACE", "DOT",
-    // tags
-    "TAG", "TAGID", "TAGCLASS", "ATTRKEY", "ATTREQ",
-    // text
-    "TEXT", "TAGTEXT",
-    // keywords
-	"IF", "ELIF", "ELSE", "CASE", "WHEN", "FOR", "EACH", "IN", "IS", "AS", "WITH", "ALIAS", "UNALIAS", "INCLUDE",
-    // loop control
-    "BREAK", "CONTINUE",
-    // conditions
-    "EQ", "NEQ", "GTE", "LTE", "GT", "LT", "MOD", "EXISTS",
-	// names
-	"ID",
-	// values
-	"STR", "ISTR", "INT", "NUMBER",
-	// filters
-	"FILTER"
-};
+// Every keyword the lexer recognizes: token type, spelling, first and last
+// character (the table index has to be a constant expression, which
+// "if"[0] is not), and the contexts it is recognized in.
+#define KEYWORDS(X)\
+	X(IF,          "if",      'i', 'f', KW_DIRECTIVE)\
+	X(ELIF,        "elif",    'e', 'f', KW_DIRECTIVE)\
+	X(ELSE,        "else",    'e', 'e', KW_DIRECTIVE)\
+	X(CASE,        "case",    'c', 'e', KW_DIRECTIVE)\
+	X(WHEN,        "when",    'w', 'n', KW_DIRECTIVE)\
+	X(FOR,         "for",     'f', 'r', KW_DIRECTIVE)\
+	X(EACH,        "each",    'e', 'h', KW_DIRECTIVE)\
+	X(ALIAS,       "alias",   'a', 's', KW_DIRECTIVE)\
+	X(UNALIAS,     "unalias", 'u', 's', KW_DIRECTIVE)\
+	X(INCLUDE,     "include", 'i', 'e', KW_DIRECTIVE)\
+	X(WITH,        "with",    'w', 'h', KW_DIRECTIVE)\
+	X(TYPEHASH,    "Hash",    'H', 'h', KW_TYPE)\
+	X(TYPELIST,    "List",    'L', 't', KW_TYPE)\
+	X(TYPESTRING,  "String",  'S', 'g', KW_TYPE)\
+	X(TYPEINT,     "Int",     'I', 't', KW_TYPE)\
+	X(TYPENUMBER,  "Number",  'N', 'r', KW_TYPE)\
+	X(TYPEBOOLEAN, "Boolean", 'B', 'n', KW_TYPE)\
+	X(IN,          "in",      'i', 'n', KW_CONDITION | KW_BINDING)\
+	X(IS,          "is",      'i', 's', KW_CONDITION | KW_BINDING)\
+	X(NOT,         "not",     'n', 't', KW_CONDITION)\
+	X(EXISTS,      "exists",  'e', 's', KW_CONDITION)\
+	X(AS,          "as",      'a', 's', KW_BINDING)
+
+// Perfect hash on length, first and last character. The constants were
+// picked so that no two keywords share a slot; a keyword that collides
+// overwrites an initializer below, which is a compile error.
+#define KEYWORD_SLOTS 32
+#define KEYWORD_HASH(LEN, FIRST, LAST) (((LEN) * 5 + (FIRST) * 14 + (LAST)) & (KEYWORD_SLOTS - 1))
+
+typedef struct Keyword {
+	const char *str;
+	int length;
+	TokenType type;
+	unsigned context;
+} Keyword;
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic error "-Woverride-init"
+#define KEYWORD_SLOT(TYPE, STR, FIRST, LAST, CONTEXT)\
+	[KEYWORD_HASH(sizeof(STR) - 1, FIRST, LAST)] = { STR, sizeof(STR) - 1, TYPE, CONTEXT },
+static const Keyword keywords[KEYWORD_SLOTS] = { KEYWORDS(KEYWORD_SLOT) };
+#undef KEYWORD_SLOT
+#pragma GCC diagnostic pop
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. . 
+// The keyword str[0, length) stands for in context, or ILLEGAL.
+TokenType keyword_lookup(const char *str, int length, unsigned context) 
+{
+	if (length == 0)
+		return ILLEGAL;
+
+	const Keyword *kw = &keywords[KEYWORD_HASH(length, str[0], str[length-1])];
+
+	if (kw->length == length && (kw->context & context) && memcmp(kw->str, str, length) == 0)
+		return kw->type;
+
+	return ILLEGAL;
+}
+
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. . 
+// Write the value of lazy token tok into dst, which has room for
+// tok->length + TOKEN_LAZY_EXTRA + 1 bytes, and return its length.
+int Token_expand(const Token *tok, const char *src, char *dst) 
+{
+	const char *p = src + tok->offset, *end = p + tok->length;
+	char quote = tok->lazy == LAZY_DQUOTE ? '"' : '\'';
+	int length = 0;
+
+	switch (tok->lazy) {
+	case LAZY_DQUOTE:
+	case LAZY_SQUOTE:
+		for (; p < end; p++) {
+			if (*p == '\\' && p + 1 < end && p[1] == quote)
+				p++;
+			dst[length++] = *p;
+		}
+		break;
+	case LAZY_DATA_KEY:
+		memcpy(dst, "data-", 5);
+		memcpy(dst + 5, p, tok->length);
+		length = tok->length + 5;
+		break;
+	default:
+		memcpy(dst, p, tok->length);
+		length = tok->length;
+		break;
+	}
+
+	dst[length] = '\0';
+	return length;
+}
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. . 
-Token *Token_new(TokenType type, char *value, int length, int line, int pos) 
+// Build tok's value in arena if it's lazy. Returns -1 if it can't be
+// allocated, leaving tok as it was.
+int Token_materialize(Token *tok, const char *src, Arena *arena) 
 {
-	Token *tok = malloc(sizeof(Token));
+	if (tok->lazy == LAZY_NONE)
+		return 0;
+
+	char *value = Arena_alloc(arena, tok->length + TOKEN_LAZY_EXTRA + 1);
+	if (value == NULL)
+		return -1;
+	mem_arena(arena, MEM_TOKENS, tok->length + TOKEN_LAZY_EXTRA + 1);
 
-	tok->type = type;
-	tok->value = strdup(value);
-	tok->length = length;
-	tok->line = line;
-	tok->pos = pos;
+	tok->length = Token_expand(tok, src, value);
+	tok->value = value;
+	tok->lazy = LAZY_NONE;
 
-	return tok;
+	return 0;
 }
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. . 
-void Token_print(Token *tok) 
+void Token_print(Token *tok, const char *src) 
 {
 	printf("Token: %s\n", tokens[tok->type]);
 	printf("\ttype: %s (%d)\n", tokens[tok->type], tok->type);
 	printf("\tline: %d\n", tok->line);
-	printf("\tpos: %d\n", tok->pos);
-	printf("\tvalue: |%s|\n", tok->value);
+	printf("\toffset: %d\n", tok->offset);
+	printf("\tvalue: |%.*s|\n", tok->length, Token_value(tok, src));
 	printf("\tlength: %d\n", tok->length);
+	if (tok->symbol)
+		printf("\tsymbol: %u\n", tok->symbol);
 	puts("\n");
 }
@@ -2,54 +2,111 @@
 #define _MANANA_TOKENS_H
 
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <assert.h>
 #include "debug.h"
 #include "array.h"
+#include "arena.h"
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
-char *tokens[61];
+// Every token type, in order. Both the TokenType enum and the tokens[]
+// name table in tokens.c are generated from this list.
+#define TOKEN_TYPES(X)\
+	/* special */\
+	X(ILLEGAL) X(END) X(NEWLINE)\
+	/* whitespace */\
+	X(INDENT) X(DEDENT) X(SPACE)\
+	/* boolean */\
+	X(TRUE) X(FALSE) X(AND) X(OR) X(NOT)\
+	/* data types */\
+	X(TYPEHASH) X(TYPELIST) X(TYPESTRING) X(TYPEINT) X(TYPENUMBER) X(TYPEBOOLEAN)\
+	/* punctuation */\
+	X(LPAREN) X(RPAREN) X(LBRACK) X(RBRACK) X(LBRACE) X(RBRACE) X(DOT)\
+	/* tags */\
+	X(TAG) X(TAGID) X(TAGCLASS) X(ATTRKEY) X(ATTREQ)\
+	/* text */\
+	X(TEXT) X(TAGTEXT)\
+	/* keywords */\
+	X(IF) X(ELIF) X(ELSE) X(CASE) X(WHEN) X(FOR) X(EACH) X(IN) X(IS) X(AS) X(WITH) X(ALIAS) X(UNALIAS) X(INCLUDE)\
+	/* loop control */\
+	X(BREAK) X(CONTINUE)\
+	/* conditions */\
+	X(EQ) X(NEQ) X(GTE) X(LTE) X(GT) X(LT) X(MOD) X(EXISTS)\
+	/* names */\
+	X(ID)\
+	/* values */\
+	X(STR) X(ISTR) X(INT) X(NUMBER)\
+	/* filters */\
+	X(FILTER)
 
+#define TOKEN_ENUM(N) N,
+typedef enum { TOKEN_TYPES(TOKEN_ENUM) TOKEN_TYPE_COUNT } TokenType;
+#undef TOKEN_ENUM
+
+extern const char *const tokens[];
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Where a keyword is recognized. "in" and "is" are both conditions and
+// bindings ("-for x in y", "-alias x as y").
 typedef enum {
-	// special
-	ILLEGAL, END, NEWLINE,
-	// whitespace
-	INDENT, DEDENT, SPACE,
-	// boolean
-	TRUE, FALSE, AND, OR, NOT, 
-	// data types
-	TYPEHASH, TYPELIST, TYPESTRING, TYPEINT, TYPENUMBER, TYPEBOOLEAN,
-	// punctuation
-	LPAREN, RPAREN, LBRACK, RBRACK, LBRACE, RBRACE, DOT,
-	// tags
-	TAG, TAGID, TAGCLASS, ATTRKEY, ATTREQ,
-	// text
-	TEXT, TAGTEXT,
-	// keywords
-	IF, ELIF, ELSE, CASE, WHEN, FOR, EACH, IN, IS, AS, WITH, ALIAS, UNALIAS, INCLUDE, 
-	// loop control
-	BREAK, CONTINUE,
-	// conditions
-	EQ, NEQ, GTE, LTE, GT, LT, MOD, EXISTS,
-	// names
-	ID,
-	// values
-	STR, ISTR, INT, NUMBER,
-	// filters
-	FILTER
-} TokenType;
+	KW_DIRECTIVE = 1 << 0, // after "-": if, for, include, ...
+	KW_TYPE      = 1 << 1, // in conditions: Hash, List, ...
+	KW_CONDITION = 1 << 2, // in conditions: in, is, not, exists
+	KW_BINDING   = 1 << 3  // in -for/-alias: in, as, is
+} KeywordContext;
+
+TokenType keyword_lookup(const char *str, int length, unsigned context);
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Values that differ from their slice of the source in a way that can be
+// worked out from it again. The lexer records only the slice and how to
+// read it; the value is built when something first asks for it.
+typedef enum {
+	LAZY_NONE,
+	LAZY_DQUOTE,   // "string" with \" escapes in it
+	LAZY_SQUOTE,   // 'string' with \' escapes in it
+	LAZY_DATA_KEY  // *key, which stands for data-key
+} TokenLazy;
+
+// Longest value a lazy slice can expand to, past its length.
+#define TOKEN_LAZY_EXTRA 5
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Token values are not copied: a token is the slice src[offset, offset + length)
+// of the source it was lexed from. Only implied values that aren't in the
+// source at all (tag names, href/src, "=") set value, which then points at
+// a string literal.
+//
+// Unescaped strings and "data-" keys are lazy instead: the lexer emits the
+// raw slice with lazy set, and Token_materialize builds the value when
+// it's wanted, after which length is the value's length. Tokens read back
+// from a TokenStream are always materialized.
+//
+// Names (TAG, TAGID, TAGCLASS, ATTRKEY) also carry symbol, the value's
+// Symbol in the SymbolTable they were lexed against (see symbols.h), or 0
+// when lexed without one.
+//
+// Tokens aren't stored like this (see stream.h); a Token is what you get
+// back when reading one from a TokenStream.
 typedef struct Token {
 	TokenType type;
-	int line, pos, length;
-	void *value;
+	int line, offset, length;
+	const char *value;
+	uint32_t symbol;
+	uint8_t lazy;
 } Token;
 
+#define Token_has_symbol(T) ((T) == TAG || (T) == TAGID || (T) == TAGCLASS || (T) == ATTRKEY)
+
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
-Token *Token_new(TokenType type, char *value, int length, int line, int pos);
+static inline const char *Token_value(Token *tok, const char *src) {
+	return tok->value ? tok->value : src + tok->offset;
+}
 
-void Token_print(Token *tok);
+int Token_expand(const Token *tok, const char *src, char *dst);
+int Token_materialize(Token *tok, const char *src, Arena *arena);
+void Token_print(Token *tok, const char *src);
 
 // . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
 #endif
@@ -0,0 +1,708 @@
+// Generate the tables the DFA lexer runs (see dfa.h) from a grammar:
+//
+//     tools/gendfa lexer.grammar dfa_tables.h
+//
+// Every line of the grammar is a rule: the mode it belongs to, a pattern,
+// the action dfa.c takes on a match, the token it emits (or -) and how
+// many characters at the start of the match the token's value leaves out.
+// Patterns are regular expressions over bytes: literals, \-escapes (\n,
+// \t and \0 are the control characters, anything else stands for itself),
+// [classes] with ranges and ^, "." for anything but newline and NUL,
+// grouping, | and the * + ? repeats. Columns are separated by spaces, so
+// a space in a pattern has to be escaped or in a class. Blank lines and #
+// comments are skipped.
+//
+// Each mode becomes a DFA through the usual NFA and subset construction,
+// all of them in one minimized table over byte classes, bytes no pattern
+// tells apart sharing a column. A state accepts for the first rule listed
+// of those that match there; dfa.c keeps the longest match. The output is
+// only written if the whole grammar is good.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include "debug.h"
+
+#define MAX_RULES 250
+#define MAX_MODES 32
+#define MAX_ACTIONS 64
+#define MAX_NFA 16384
+#define MAX_DFA 1024
+#define MAX_NAME 32
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+typedef struct Charset {
+	uint64_t bits[4];
+} Charset;
+
+static inline void Charset_add(Charset *set, int c) {
+	set->bits[c >> 6] |= 1ULL << (c & 63);
+}
+
+static inline int Charset_has(const Charset *set, int c) {
+	return (set->bits[c >> 6] >> (c & 63)) & 1;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// NFA_CHAR moves on a byte in set to out; NFA_SPLIT moves to out and out2
+// without reading anything, NFA_EMPTY to out only. NFA_ACCEPT ends rule.
+typedef enum { NFA_CHAR, NFA_SPLIT, NFA_EMPTY, NFA_ACCEPT } NfaType;
+
+typedef struct NfaState {
+	NfaType type;
+	Charset set;
+	int out, out2, rule;
+} NfaState;
+
+// A piece of NFA under construction: start, and end, an NFA_EMPTY whose
+// out is still to be filled in.
+typedef struct Fragment {
+	int start, end;
+} Fragment;
+
+typedef struct Rule {
+	int mode, action, skip, line;
+	char token[MAX_NAME];
+} Rule;
+
+typedef struct Grammar {
+	Rule rules[MAX_RULES];
+	int rule_count;
+	char modes[MAX_MODES][MAX_NAME];
+	int mode_count;
+	char actions[MAX_ACTIONS][MAX_NAME];
+	int action_count;
+} Grammar;
+
+static NfaState nfa[MAX_NFA];
+static int nfa_count = 0;
+
+static Grammar grammar;
+
+// Where parse errors are reported: the line and the pattern being parsed.
+static int line_number = 0;
+static const char *pattern = NULL;
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static int Nfa_add(NfaType type, int out, int out2) {
+	check(nfa_count < MAX_NFA, "More than %d NFA states.", MAX_NFA);
+
+	NfaState *state = &nfa[nfa_count];
+	memset(state, 0, sizeof(NfaState));
+	state->type = type;
+	state->out = out;
+	state->out2 = out2;
+	state->rule = -1;
+	return nfa_count++;
+error:
+	exit(1);
+}
+
+static Fragment Fragment_charset(const Charset *set) {
+	int end = Nfa_add(NFA_EMPTY, -1, -1);
+	int start = Nfa_add(NFA_CHAR, end, -1);
+
+	nfa[start].set = *set;
+	return (Fragment){ start, end };
+}
+
+static Fragment Fragment_empty() {
+	int end = Nfa_add(NFA_EMPTY, -1, -1);
+	return (Fragment){ Nfa_add(NFA_EMPTY, end, -1), end };
+}
+
+static Fragment Fragment_concat(Fragment a, Fragment b) {
+	nfa[a.end].out = b.start;
+	return (Fragment){ a.start, b.end };
+}
+
+static Fragment Fragment_alternate(Fragment a, Fragment b) {
+	int end = Nfa_add(NFA_EMPTY, -1, -1);
+
+	nfa[a.end].out = end;
+	nfa[b.end].out = end;
+	return (Fragment){ Nfa_add(NFA_SPLIT, a.start, b.start), end };
+}
+
+// op is *, + or ?.
+static Fragment Fragment_repeat(Fragment a, char op) {
+	int end = Nfa_add(NFA_EMPTY, -1, -1);
+
+	if (op == '?') {
+		nfa[a.end].out = end;
+		return (Fragment){ Nfa_add(NFA_SPLIT, a.start, end), end };
+	}
+
+	nfa[a.end].type = NFA_SPLIT;
+	nfa[a.end].out = a.start;
+	nfa[a.end].out2 = end;
+
+	if (op == '+')
+		return (Fragment){ a.start, end };
+
+	return (Fragment){ Nfa_add(NFA_SPLIT, a.start, end), end };
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+__attribute__((noreturn))
+static void parse_error(const char *p, const char *message) {
+	log_err("line %d: %s at \"%s\" in %s", line_number, message, p, pattern);
+	exit(1);
+}
+
+static int parse_escape(const char **p) {
+	char c = *(*p)++;
+
+	switch (c) {
+	case 'n': return '\n';
+	case 't': return '\t';
+	case '0': return '\0';
+	case '\0': parse_error(*p - 1, "Dangling \\");
+	default: return (unsigned char)c;
+	}
+}
+
+static int parse_class_char(const char **p) {
+	if (**p == '\0')
+		parse_error(*p, "Unclosed [");
+	if (**p == '\\') {
+		(*p)++;
+		return parse_escape(p);
+	}
+	return (unsigned char)*(*p)++;
+}
+
+// After the [.
+static Fragment parse_class(const char **p) {
+	Charset set = { { 0, 0, 0, 0 } };
+	int negate = 0, c;
+
+	if (**p == '^') {
+		negate = 1;
+		(*p)++;
+	}
+
+	while (**p != ']') {
+		int from = parse_class_char(p), to = from;
+
+		if (**p == '-' && (*p)[1] != ']') {
+			(*p)++;
+			to = parse_class_char(p);
+			if (to < from)
+				parse_error(*p, "Backwards range");
+		}
+
+		for (c = from; c <= to; c++)
+			Charset_add(&set, c);
+	}
+	(*p)++;
+
+	if (negate) {
+		for (c = 0; c < 4; c++)
+			set.bits[c] = ~set.bits[c];
+	}
+
+	return Fragment_charset(&set);
+}
+
+static Fragment parse_alternation(const char **p);
+
+static Fragment parse_atom(const char **p) {
+	Charset set = { { 0, 0, 0, 0 } };
+	int c;
+
+	switch (**p) {
+	case '(': {
+		(*p)++;
+		Fragment inner = parse_alternation(p);
+		if (**p != ')')
+			parse_error(*p, "Unclosed (");
+		(*p)++;
+		return inner;
+	}
+	case '[':
+		(*p)++;
+		return parse_class(p);
+	case '.':
+		(*p)++;
+		for (c = 0; c < 256; c++) {
+			if (c != '\n' && c != '\0')
+				Charset_add(&set, c);
+		}
+		return Fragment_charset(&set);
+	case '\\':
+		(*p)++;
+		Charset_add(&set, parse_escape(p));
+		return Fragment_charset(&set);
+	case '*': case '+': case '?':
+		parse_error(*p, "Nothing to repeat");
+	default:
+		Charset_add(&set, (unsigned char)*(*p)++);
+		return Fragment_charset(&set);
+	}
+}
+
+static Fragment parse_repeat(const char **p) {
+	Fragment atom = parse_atom(p);
+
+	while (**p == '*' || **p == '+' || **p == '?')
+		atom = Fragment_repeat(atom, *(*p)++);
+
+	return atom;
+}
+
+static Fragment parse_concatenation(const char **p) {
+	Fragment result = Fragment_empty();
+
+	while (**p != '\0' && **p != '|' && **p != ')')
+		result = Fragment_concat(result, parse_repeat(p));
+
+	return result;
+}
+
+static Fragment parse_alternation(const char **p) {
+	Fragment result = parse_concatenation(p);
+
+	while (**p == '|') {
+		(*p)++;
+		result = Fragment_alternate(result, parse_concatenation(p));
+	}
+
+	return result;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Index of name in names, added if it isn't there yet.
+static int intern(char names[][MAX_NAME], int *count, int max, const char *name) {
+	int i;
+
+	for (i = 0; i < *count; i++) {
+		if (strcmp(names[i], name) == 0)
+			return i;
+	}
+
+	check(*count < max, "line %d: More than %d names.", line_number, max);
+	check(strlen(name) < MAX_NAME, "line %d: Name %s is too long.", line_number, name);
+	strcpy(names[*count], name);
+	return (*count)++;
+error:
+	exit(1);
+}
+
+// Copies the next column of line into field, which has room for size
+// bytes, and returns where the one after it starts. A pattern's column
+// doesn't end at a space that's escaped or inside [ ].
+static char *next_field(char *p, char *field, int size) {
+	int length = 0, in_class = 0;
+
+	while (*p == ' ' || *p == '\t')
+		p++;
+
+	for (; *p && *p != '\n' && (in_class || (*p != ' ' && *p != '\t')); p++) {
+		if (*p == '\\' && p[1] && length < size - 2)
+			field[length++] = *p++;
+		else if (*p == '[')
+			in_class = 1;
+		else if (*p == ']')
+			in_class = 0;
+
+		if (length < size - 1)
+			field[length++] = *p;
+	}
+
+	field[length] = '\0';
+	return p;
+}
+
+// Reads the grammar, building each rule's NFA, which ends in an NFA_ACCEPT.
+// starts[rule] is where it starts.
+static int Grammar_read(FILE *in, int *starts) {
+	char line[1024];
+
+	while (fgets(line, sizeof(line), in)) {
+		char mode[MAX_NAME], text[512], action[MAX_NAME], token[MAX_NAME], skip[MAX_NAME];
+
+		line_number++;
+
+		char *p = line;
+		while (isspace((unsigned char)*p))
+			p++;
+		if (*p == '\0' || *p == '#')
+			continue;
+
+		p = next_field(p, mode, sizeof(mode));
+		p = next_field(p, text, sizeof(text));
+		p = next_field(p, action, sizeof(action));
+		p = next_field(p, token, sizeof(token));
+		p = next_field(p, skip, sizeof(skip));
+
+		check(action[0], "line %d: Expected mode, pattern and action.", line_number);
+		check(grammar.rule_count < MAX_RULES, "line %d: More than %d rules.", line_number, MAX_RULES);
+
+		Rule *rule = &grammar.rules[grammar.rule_count];
+		rule->mode = intern(grammar.modes, &grammar.mode_count, MAX_MODES, mode);
+		rule->action = intern(grammar.actions, &grammar.action_count, MAX_ACTIONS, action);
+		rule->skip = atoi(skip);
+		rule->line = line_number;
+		strcpy(rule->token, token[0] && strcmp(token, "-") != 0 ? token : "ILLEGAL");
+
+		pattern = text;
+		const char *q = text;
+		Fragment fragment = parse_alternation(&q);
+		if (*q != '\0')
+			parse_error(q, "Unmatched )");
+
+		int accept = Nfa_add(NFA_ACCEPT, -1, -1);
+		nfa[accept].rule = grammar.rule_count;
+		nfa[fragment.end].out = accept;
+
+		starts[grammar.rule_count++] = fragment.start;
+	}
+
+	check(grammar.rule_count > 0, "The grammar has no rules.");
+	return 0;
+error:
+	return -1;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// A set of NFA states, sorted, as a DFA state under construction.
+typedef struct StateSet {
+	int *states;
+	int count, accept;
+} StateSet;
+
+static StateSet sets[MAX_DFA];
+static int set_count = 0;
+
+static int dfa_next[MAX_DFA][256];
+static int byte_class[256];
+static int class_count = 0;
+
+// Adds state and everything it reaches without reading a byte to set.
+static void closure(int state, char *seen, int *set, int *count) {
+	if (state < 0 || seen[state])
+		return;
+
+	seen[state] = 1;
+	set[(*count)++] = state;
+
+	if (nfa[state].type == NFA_SPLIT || nfa[state].type == NFA_EMPTY)
+		closure(nfa[state].out, seen, set, count);
+	if (nfa[state].type == NFA_SPLIT)
+		closure(nfa[state].out2, seen, set, count);
+}
+
+static int compare_int(const void *a, const void *b) {
+	return *(const int *)a - *(const int *)b;
+}
+
+// The DFA state for the NFA states in set[0, count), added if new. An empty
+// set is the dead state, 0.
+static int StateSet_find(int *set, int count) {
+	int i;
+
+	qsort(set, count, sizeof(int), compare_int);
+
+	for (i = 0; i < set_count; i++) {
+		if (sets[i].count == count && memcmp(sets[i].states, set, count * sizeof(int)) == 0)
+			return i;
+	}
+
+	check(set_count < MAX_DFA, "More than %d DFA states.", MAX_DFA);
+
+	StateSet *added = &sets[set_count];
+	added->states = malloc(count * sizeof(int) + 1);
+	check_mem(added->states);
+	memcpy(added->states, set, count * sizeof(int));
+	added->count = count;
+	added->accept = -1;
+
+	for (i = 0; i < count; i++) {
+		if (nfa[set[i]].type == NFA_ACCEPT && (added->accept < 0 || nfa[set[i]].rule < added->accept))
+			added->accept = nfa[set[i]].rule;
+	}
+
+	return set_count++;
+error:
+	exit(1);
+}
+
+// Splits the bytes into classes no NFA_CHAR tells apart: each set splits
+// every class into the bytes inside it and the bytes outside.
+static void Classes_build() {
+	int i, c;
+
+	memset(byte_class, 0, sizeof(byte_class));
+	class_count = 1;
+
+	for (i = 0; i < nfa_count; i++) {
+		int split[2][256], count = 0;
+
+		if (nfa[i].type != NFA_CHAR)
+			continue;
+
+		memset(split, -1, sizeof(split));
+		for (c = 0; c < 256; c++) {
+			int *to = &split[Charset_has(&nfa[i].set, c)][byte_class[c]];
+			if (*to < 0)
+				*to = count++;
+			byte_class[c] = *to;
+		}
+		class_count = count;
+	}
+}
+
+// Subset construction for the rules of mode, from starts. Returns the
+// DFA state it starts in.
+static int Mode_build(int mode, int *starts) {
+	char *seen = calloc(nfa_count, 1);
+	int *set = malloc(nfa_count * sizeof(int));
+	int count = 0, rule, first, state, c;
+
+	check_mem(seen);
+	check_mem(set);
+
+	for (rule = 0; rule < grammar.rule_count; rule++) {
+		if (grammar.rules[rule].mode == mode)
+			closure(starts[rule], seen, set, &count);
+	}
+
+	first = set_count;
+	int start = StateSet_find(set, count);
+
+	for (state = first; state < set_count; state++) {
+		int representative[256];
+
+		for (c = 0; c < 256; c++)
+			representative[byte_class[c]] = c;
+
+		int class;
+		for (class = 0; class < class_count; class++) {
+			int byte = representative[class], i;
+
+			memset(seen, 0, nfa_count);
+			count = 0;
+
+			for (i = 0; i < sets[state].count; i++) {
+				NfaState *from = &nfa[sets[state].states[i]];
+				if (from->type == NFA_CHAR && Charset_has(&from->set, byte))
+					closure(from->out, seen, set, &count);
+			}
+
+			int to = count ? StateSet_find(set, count) : 0;
+			for (c = 0; c < 256; c++) {
+				if (byte_class[c] == class)
+					dfa_next[state][c] = to;
+			}
+		}
+	}
+
+	free(seen);
+	free(set);
+	return start;
+error:
+	exit(1);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Merges states no input tells apart (Moore's algorithm): start from one
+// block per rule accepted and split blocks until every state in a block
+// moves to the same blocks. block[state] is what's left, and the number of
+// blocks is returned. The dead state stays 0.
+static int Dfa_minimize(int *block) {
+	static int signature[MAX_DFA][257];
+	int next_block[MAX_DFA];
+	int blocks = 0, state, other, c;
+
+	for (state = 0; state < set_count; state++)
+		block[state] = state == 0 ? 0 : sets[state].accept + 2;
+
+	for (;;) {
+		for (state = 0; state < set_count; state++) {
+			signature[state][0] = block[state];
+			for (c = 0; c < class_count; c++) {
+				int byte;
+				for (byte = 0; byte_class[byte] != c; byte++)
+					;
+				signature[state][c + 1] = block[dfa_next[state][byte]];
+			}
+		}
+
+		int count = 0;
+		for (state = 0; state < set_count; state++) {
+			for (other = 0; other < state; other++) {
+				if (memcmp(signature[state], signature[other], (class_count + 1) * sizeof(int)) == 0)
+					break;
+			}
+			next_block[state] = other < state ? next_block[other] : count++;
+		}
+
+		int changed = count != blocks;
+		for (state = 0; state < set_count; state++)
+			block[state] = next_block[state];
+		blocks = count;
+
+		if (!changed)
+			break;
+	}
+
+	return blocks;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static void upper(FILE *out, const char *name) {
+	for (; *name; name++)
+		fputc(toupper((unsigned char)*name), out);
+}
+
+static int Tables_write(const char *path, int *mode_starts, int *block, int blocks) {
+	int representative[MAX_DFA], accept[MAX_DFA];
+	int state, i, c;
+	FILE *out = NULL;
+
+	for (i = 0; i < blocks; i++)
+		representative[i] = -1;
+	for (state = 0; state < set_count; state++) {
+		if (representative[block[state]] < 0)
+			representative[block[state]] = state;
+		accept[block[state]] = state == 0 ? -1 : sets[state].accept;
+	}
+
+	out = fopen(path, "w");
+	check(out, "Can't write %s", path);
+
+	fprintf(out, "// Generated from lexer.grammar by tools/gendfa: %d rules, %d modes,\n"
+			"// %d states over %d byte classes. Edit the grammar, not this.\n\n",
+			grammar.rule_count, grammar.mode_count, blocks, class_count);
+	fprintf(out, "#ifndef _MANANA_DFA_TABLES_H\n#define _MANANA_DFA_TABLES_H\n\n");
+	fprintf(out, "#include <stdint.h>\n#include \"tokens.h\"\n\n");
+
+	fprintf(out, "typedef enum {");
+	for (i = 0; i < grammar.mode_count; i++) {
+		fprintf(out, "%sMODE_", i ? ", " : " ");
+		upper(out, grammar.modes[i]);
+	}
+	fprintf(out, ", DFA_MODE_COUNT } DfaMode;\n\n");
+
+	fprintf(out, "typedef enum {");
+	for (i = 0; i < grammar.action_count; i++) {
+		fprintf(out, "%sACTION_", i ? ", " : " ");
+		upper(out, grammar.actions[i]);
+	}
+	fprintf(out, ", DFA_ACTION_COUNT } DfaAction;\n\n");
+
+	fprintf(out, "typedef struct DfaRule {\n\tuint8_t action, token, skip;\n} DfaRule;\n\n");
+	fprintf(out, "typedef %s DfaState;\n\n", blocks <= 256 ? "uint8_t" : "uint16_t");
+
+	fprintf(out, "#define DFA_STATES %d\n#define DFA_CLASSES %d\n\n", blocks, class_count);
+
+	fprintf(out, "static const uint8_t dfa_class[256] = {");
+	for (c = 0; c < 256; c++)
+		fprintf(out, "%s%d,", c % 16 ? " " : "\n\t", byte_class[c]);
+	fprintf(out, "\n};\n\n");
+
+	fprintf(out, "static const DfaState dfa_start[DFA_MODE_COUNT] = {");
+	for (i = 0; i < grammar.mode_count; i++)
+		fprintf(out, " %d,", block[mode_starts[i]]);
+	fprintf(out, " };\n\n");
+
+	fprintf(out, "static const DfaState dfa_next[DFA_STATES][DFA_CLASSES] = {\n");
+	for (i = 0; i < blocks; i++) {
+		fprintf(out, "\t{");
+		for (c = 0; c < class_count; c++) {
+			int byte;
+			for (byte = 0; byte_class[byte] != c; byte++)
+				;
+			fprintf(out, "%s%d", c ? ", " : " ", block[dfa_next[representative[i]][byte]]);
+		}
+		fprintf(out, " },\n");
+	}
+	fprintf(out, "};\n\n");
+
+	fprintf(out, "// The rule a state accepts for, plus one; 0 if it doesn't accept.\n");
+	fprintf(out, "static const uint8_t dfa_accept[DFA_STATES] = {");
+	for (i = 0; i < blocks; i++)
+		fprintf(out, "%s%d,", i % 16 ? " " : "\n\t", accept[i] + 1);
+	fprintf(out, "\n};\n\n");
+
+	fprintf(out, "static const DfaRule dfa_rules[] = {\n");
+	for (i = 0; i < grammar.rule_count; i++) {
+		Rule *rule = &grammar.rules[i];
+		fprintf(out, "\t{ ACTION_");
+		upper(out, grammar.actions[rule->action]);
+		fprintf(out, ", %s, %d }, // line %d, %s\n", rule->token, rule->skip, rule->line, grammar.modes[rule->mode]);
+	}
+	fprintf(out, "};\n\n#endif\n");
+
+	int closed = fclose(out);
+	out = NULL;
+	check(closed == 0, "Can't write %s", path);
+	return 0;
+error:
+	if (out)
+		fclose(out);
+	remove(path);
+	return -1;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+int main(int argc, char *argv[]) {
+	static int starts[MAX_RULES], block[MAX_DFA];
+	int mode_starts[MAX_MODES];
+	int mode, state, rule;
+	FILE *in = NULL;
+
+	check(argc == 3, "usage: %s GRAMMAR OUTPUT", argv[0]);
+
+	in = fopen(argv[1], "r");
+	check(in, "Can't open %s", argv[1]);
+	check(Grammar_read(in, starts) == 0, "Bad grammar %s", argv[1]);
+	fclose(in);
+	in = NULL;
+
+	Classes_build();
+
+	// The dead state.
+	int none = 0;
+	StateSet_find(&none, 0);
+
+	for (mode = 0; mode < grammar.mode_count; mode++)
+		mode_starts[mode] = Mode_build(mode, starts);
+
+	// dfa.c only takes matches of at least one byte, and reads one byte
+	// past the last it matched, which after a NUL may be past the source.
+	for (mode = 0; mode < grammar.mode_count; mode++) {
+		check(sets[mode_starts[mode]].accept < 0, "Mode %s has a rule that matches nothing, line %d.",
+				grammar.modes[mode], grammar.rules[sets[mode_starts[mode]].accept].line);
+	}
+
+	// Modes' states were numbered one mode after the other.
+	for (mode = 0; mode < grammar.mode_count; mode++) {
+		int end = mode + 1 < grammar.mode_count ? mode_starts[mode + 1] : set_count;
+
+		for (state = mode_starts[mode]; state < end; state++) {
+			int after = dfa_next[state][0], c;
+			for (c = 0; after && c < 256; c++)
+				check(dfa_next[after][c] == 0, "A pattern in mode %s goes on past \\0.", grammar.modes[mode]);
+		}
+	}
+
+	// Every rule has to be able to win somewhere, or it's a mistake.
+	for (rule = 0; rule < grammar.rule_count; rule++) {
+		for (state = 1; state < set_count && sets[state].accept != rule; state++)
+			;
+		check(state < set_count, "line %d: Rule can never match; an earlier one always wins.",
+				grammar.rules[rule].line);
+	}
+
+	int blocks = Dfa_minimize(block);
+	check(Tables_write(argv[2], mode_starts, block, blocks) == 0, "Failed to write the tables.");
+	return 0;
+error:
+	if (in)
+		fclose(in);
+	return 1;
+}
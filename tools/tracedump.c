@@ -0,0 +1,68 @@
+// Decode a trace file written by Trace_dump into one line per record:
+//
+//     MANANA_TRACE=lexer ./manana && tools/tracedump manana.trace
+//
+// Lexer records carry (pos, ch) of the state they were entered at,
+// indent records (level, depth) and stream records (token, chunks).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include "debug.h"
+#include "trace.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static void print_record(uint32_t thread, TraceRecord *rec, uint64_t t0) {
+	const char *name = rec->event < TRACE_EVENT_COUNT ? trace_events[rec->event] : "?";
+
+	printf("%12.3f us  [%u] %-20s", (rec->time - t0) / 1000.0, thread, name);
+
+	if (rec->subsystem == TRACE_LEXER) {
+		int ch = rec->b;
+		printf(" @%u  %s%c\n", rec->a,
+				isprint(ch) ? "" : "\\", isprint(ch) ? ch : (ch == '\n' ? 'n' : '0'));
+	} else {
+		printf(" %u %u %u\n", rec->a, rec->b, rec->c);
+	}
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+int main(int argc, char *argv[]) {
+	TraceRecord *records = NULL;
+	FILE *f = NULL;
+
+	check(argc == 2, "usage: %s FILE", argv[0]);
+
+	f = fopen(argv[1], "rb");
+	check(f, "Can't open %s", argv[1]);
+
+	TraceFileHeader header;
+	check(fread(&header, sizeof(header), 1, f) == 1, "Truncated trace file.");
+	check(header.magic == TRACE_FILE_MAGIC, "Not a trace file.");
+	check(header.version == TRACE_FILE_VERSION && header.record_size == sizeof(TraceRecord),
+			"Trace file version %u is not supported.", header.version);
+
+	records = malloc(sizeof(TraceRecord) * TRACE_RING_SIZE);
+	check_mem(records);
+
+	uint32_t r;
+	for (r = 0; r < header.rings; r++) {
+		TraceFileRing ring;
+		check(fread(&ring, sizeof(ring), 1, f) == 1, "Truncated trace file.");
+		check(ring.count <= TRACE_RING_SIZE, "Corrupt trace file.");
+		check(fread(records, sizeof(TraceRecord), ring.count, f) == ring.count, "Truncated trace file.");
+
+		uint32_t i;
+		for (i = 0; i < ring.count; i++)
+			print_record(ring.thread, &records[i], records[0].time);
+	}
+
+	free(records);
+	fclose(f);
+	return 0;
+error:
+	free(records);
+	if (f)
+		fclose(f);
+	return 1;
+}
@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "debug.h"
+#include "trace.h"
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+#define TRACE_EVENT_NAME(N) #N,
+const char *const trace_events[] = { TRACE_EVENTS(TRACE_EVENT_NAME) };
+#undef TRACE_EVENT_NAME
+
+_Atomic unsigned trace_mask = 0;
+
+// Every thread's ring, newest first. Rings are only ever added.
+static TraceRing *_Atomic trace_rings = NULL;
+static _Atomic uint32_t trace_threads = 0;
+static __thread TraceRing *trace_ring = NULL;
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+static TraceRing *Trace_ring_create() {
+	TraceRing *ring = calloc(1, sizeof(TraceRing));
+	check_mem(ring);
+
+	ring->thread = atomic_fetch_add(&trace_threads, 1);
+	ring->next = atomic_load(&trace_rings);
+	while (!atomic_compare_exchange_weak(&trace_rings, &ring->next, ring))
+		;
+
+	return ring;
+error:
+	return NULL;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+void Trace_record(unsigned subsystem, unsigned event, uint32_t a, uint32_t b, uint32_t c) {
+	if (trace_ring == NULL && (trace_ring = Trace_ring_create()) == NULL)
+		return;
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	uint64_t head = atomic_load_explicit(&trace_ring->head, memory_order_relaxed);
+	TraceRecord *rec = &trace_ring->records[head & TRACE_RING_MASK];
+
+	rec->time = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+	rec->subsystem = subsystem;
+	rec->event = event;
+	rec->a = a;
+	rec->b = b;
+	rec->c = c;
+
+	atomic_store_explicit(&trace_ring->head, head + 1, memory_order_release);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// "lexer,indent" => TRACE_LEXER | TRACE_INDENT. Unknown names are ignored.
+unsigned Trace_parse(const char *spec) {
+	static const struct { const char *name; unsigned mask; } names[] = {
+		{ "lexer", TRACE_LEXER }, { "indent", TRACE_INDENT },
+		{ "stream", TRACE_STREAM }, { "debug", TRACE_DEBUG },
+		{ "all", TRACE_ALL }
+	};
+	unsigned mask = 0;
+
+	while (spec && *spec) {
+		size_t len = strcspn(spec, ",");
+		size_t i;
+
+		for (i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+			if (strlen(names[i].name) == len && strncmp(spec, names[i].name, len) == 0)
+				mask |= names[i].mask;
+		}
+
+		spec += len;
+		if (*spec == ',')
+			spec++;
+	}
+
+	return mask;
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+void Trace_enable(unsigned mask) {
+	atomic_store(&trace_mask, mask);
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+#ifdef MANANA_TRACE
+static const char *trace_path = NULL;
+
+static void Trace_dump_at_exit() {
+	Trace_dump(trace_path);
+}
+#endif
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// MANANA_TRACE selects subsystems, MANANA_TRACE_FILE where the rings are
+// written at exit (default manana.trace).
+void Trace_init_from_env() {
+#ifdef MANANA_TRACE
+	unsigned mask = Trace_parse(getenv("MANANA_TRACE"));
+	if (mask == 0)
+		return;
+
+	trace_path = getenv("MANANA_TRACE_FILE");
+	if (trace_path == NULL)
+		trace_path = "manana.trace";
+
+	Trace_enable(mask);
+	atexit(Trace_dump_at_exit);
+#endif
+}
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Rings are written as they are when this is called; records a thread is
+// writing concurrently may be torn, so dump after the work is done.
+int Trace_dump(const char *path) {
+	FILE *f = fopen(path, "wb");
+	check(f, "Can't open trace file %s", path);
+
+	TraceFileHeader header = { TRACE_FILE_MAGIC, TRACE_FILE_VERSION, 0, sizeof(TraceRecord) };
+	TraceRing *ring;
+
+	for (ring = atomic_load(&trace_rings); ring; ring = ring->next)
+		header.rings++;
+	fwrite(&header, sizeof(header), 1, f);
+
+	for (ring = atomic_load(&trace_rings); ring; ring = ring->next) {
+		uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+		uint64_t first = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+		TraceFileRing info = { ring->thread, (uint32_t)(head - first) };
+		uint64_t i;
+
+		fwrite(&info, sizeof(info), 1, f);
+		for (i = first; i < head; i++)
+			fwrite(&ring->records[i & TRACE_RING_MASK], sizeof(TraceRecord), 1, f);
+	}
+
+	fclose(f);
+	return 0;
+error:
+	return -1;
+}
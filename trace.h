@@ -0,0 +1,95 @@
+#ifndef _MANANA_TRACE_H
+#define _MANANA_TRACE_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+// Tracing is compiled in only with -DMANANA_TRACE (make TRACE=1). Without
+// it every trace() compiles to nothing. With it, a subsystem is traced
+// only when its bit is set in trace_mask, e.g. MANANA_TRACE=lexer,indent.
+//
+// Records are not formatted: each thread appends fixed-size binary records
+// to its own ring buffer, which Trace_dump writes out for tools/tracedump
+// to decode. Only the owning thread writes to a ring, so no locks are taken.
+typedef enum {
+	TRACE_LEXER  = 1 << 0,
+	TRACE_INDENT = 1 << 1,
+	TRACE_STREAM = 1 << 2,
+	TRACE_DEBUG  = 1 << 3,
+	TRACE_ALL    = 0xff
+} TraceSubsystem;
+
+#define TRACE_EVENTS(X)\
+	X(DEBUG_MSG)\
+	X(LEX_INITIAL) X(LEX_INDENT) X(LEX_TAG) X(LEX_TAG_ID) X(LEX_TAG_CLASS)\
+	X(LEX_TAG_ATTRS) X(LEX_TAG_INLINE_VARS) X(LEX_TAG_TEXT) X(LEX_TEXT)\
+	X(LEX_NAME) X(LEX_NAME_NO_DELIM) X(LEX_STR) X(LEX_COMMENT) X(LEX_LOGIC)\
+	X(LEX_IF) X(LEX_FOR) X(LEX_EACH) X(LEX_CASE) X(LEX_WHEN) X(LEX_WITH)\
+	X(LEX_ALIAS) X(LEX_UNALIAS) X(LEX_INCLUDE) X(LEX_FILTER) X(LEX_KEYWORD)\
+	X(LEX_ID) X(LEX_EOF)\
+	X(INDENT_PUSH) X(INDENT_POP)\
+	X(STREAM_CHUNK)
+
+#define TRACE_EVENT_ENUM(N) TRACE_##N,
+typedef enum { TRACE_EVENTS(TRACE_EVENT_ENUM) TRACE_EVENT_COUNT } TraceEvent;
+#undef TRACE_EVENT_ENUM
+
+extern const char *const trace_events[];
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+typedef struct TraceRecord {
+	uint64_t time;
+	uint16_t subsystem, event;
+	uint32_t a, b, c;
+} TraceRecord;
+
+#define TRACE_RING_BITS 16
+#define TRACE_RING_SIZE (1 << TRACE_RING_BITS)
+#define TRACE_RING_MASK (TRACE_RING_SIZE - 1)
+
+typedef struct TraceRing {
+	struct TraceRing *next;
+	uint32_t thread;
+	_Atomic uint64_t head;
+	TraceRecord records[TRACE_RING_SIZE];
+} TraceRing;
+
+// Trace file layout: TraceFileHeader, then for each ring a TraceFileRing
+// followed by its records, oldest first.
+#define TRACE_FILE_MAGIC 0x4352544d // "MTRC"
+#define TRACE_FILE_VERSION 1
+
+typedef struct TraceFileHeader {
+	uint32_t magic, version, rings, record_size;
+} TraceFileHeader;
+
+typedef struct TraceFileRing {
+	uint32_t thread, count;
+} TraceFileRing;
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+extern _Atomic unsigned trace_mask;
+
+void Trace_record(unsigned subsystem, unsigned event, uint32_t a, uint32_t b, uint32_t c);
+unsigned Trace_parse(const char *spec);
+void Trace_enable(unsigned mask);
+void Trace_init_from_env();
+int Trace_dump(const char *path);
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+#ifdef MANANA_TRACE
+#define trace_enabled(SUB) (atomic_load_explicit(&trace_mask, memory_order_relaxed) & (SUB))
+#define trace(SUB, EVENT, A, B, C)\
+	do {\
+		if (trace_enabled(SUB))\
+			Trace_record((SUB), TRACE_##EVENT, (A), (B), (C));\
+	} while (0)
+#else
+#define trace_enabled(SUB) 0
+// Arguments are cast to void, so what is only traced isn't unused.
+#define trace(SUB, EVENT, A, B, C) do { (void)(A); (void)(B); (void)(C); } while (0)
+#endif
+
+// . .. ... .. . .. ... .. . .. ... .. . .. ... .. . .. ... .. .
+#endif